@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,20 +9,40 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    apngencoder.cpp \
     canvas.cpp \
+    engineexport.cpp \
     frame.cpp \
+    gifencoder.cpp \
+    jsonproject.cpp \
     main.cpp \
     mainmenu.cpp \
     mainwindow.cpp \
-    model.cpp
+    model.cpp \
+    pixelscaler.cpp \
+    projectfile.cpp \
+    projectpreview.cpp \
+    spritesheet.cpp \
+    videostream.cpp
 
 HEADERS += \
+    apngencoder.h \
     canvas.h \
     commonDataTypes.h \
+    crc32.h \
+    engineexport.h \
     frame.h \
+    gifencoder.h \
+    jsonproject.h \
     mainmenu.h \
     mainwindow.h \
-    model.h
+    model.h \
+    pixelscaler.h \
+    projectfile.h \
+    projectpreview.h \
+    readprogress.h \
+    spritesheet.h \
+    videostream.h
 
 FORMS += \
     mainmenu.ui \
@@ -0,0 +1,202 @@
+#include "apngencoder.h"
+#include "parallelencode.h"
+#include "crc32.h"
+#include <QBuffer>
+#include <QRect>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <atomic>
+#include <cstring>
+
+// Delays are stored as a 16-bit count of milliseconds
+static const int maxDelay = 65535;
+static const char pngSignature[] = "\x89PNG\r\n\x1a\n";
+
+/**
+ * @brief PlannedFrame is one stored frame of the animation: the frame its pixels come from,
+ * the rectangle stored and how long it is shown
+ */
+struct PlannedFrame
+{
+    int frame;
+    QRect rect;
+    int delay;
+};
+
+static void appendBigEndian32(QByteArray& out, quint32 value)
+{
+    char bytes[4];
+    qToBigEndian<quint32>(value, bytes);
+    out.append(bytes, 4);
+}
+
+static void appendBigEndian16(QByteArray& out, quint16 value)
+{
+    char bytes[2];
+    qToBigEndian<quint16>(value, bytes);
+    out.append(bytes, 2);
+}
+
+/**
+ * @brief appendChunk appends a PNG chunk: its length, type, data and the CRC of type and data
+ */
+static void appendChunk(QByteArray& out, const char* type, const QByteArray& data)
+{
+    appendBigEndian32(out, (quint32)data.size());
+    const qsizetype start = out.size();
+    out.append(type, 4);
+    out.append(data);
+    appendBigEndian32(out, crc32((const uchar*)out.constData() + start, out.size() - start));
+}
+
+/**
+ * @brief imageData compresses an image with Qt's PNG writer and joins the data of its IDAT
+ * chunks, which together are one zlib stream
+ * @return a true/false on whether the PNG is 8-bit RGBA, not interlaced, as the animation's
+ * header declares every frame to be
+ */
+static bool imageData(const QImage& image, int compressionLevel, QByteArray& data)
+{
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    if(!image.convertToFormat(QImage::Format_ARGB32).save(&buffer, "PNG", Frame::pngQuality(compressionLevel)))
+    {
+        return false;
+    }
+
+    bool rgba = false;
+    for(qsizetype offset = 8; offset + 12 <= png.size();)
+    {
+        const quint32 length = qFromBigEndian<quint32>(png.constData() + offset);
+        const char* type = png.constData() + offset + 4;
+        const char* chunkData = type + 4;
+        if(offset + 12 + (qint64)length > png.size())
+        {
+            return false;
+        }
+        if(memcmp(type, "IHDR", 4) == 0)
+        {
+            // Bit depth 8, color type 6 (RGBA), compression, filter and interlace all 0
+            rgba = length == 13 && memcmp(chunkData + 8, "\x08\x06\x00\x00\x00", 5) == 0;
+        }
+        else if(memcmp(type, "IDAT", 4) == 0)
+        {
+            data.append(chunkData, length);
+        }
+        offset += 12 + length;
+    }
+    return rgba && !data.isEmpty();
+}
+
+/**
+ * @brief planFrames finds what each frame changed since the one before it. Frame 0 is the
+ * default image and is always stored whole
+ */
+static std::vector<PlannedFrame> planFrames(const std::vector<Frame>& frames, int frameDuration)
+{
+    const int count = (int)frames.size();
+    std::vector<QRect> changed(count);
+    std::vector<int> indices;
+    for(int i = 1; i < count; i++)
+    {
+        indices.push_back(i);
+    }
+    QtConcurrent::blockingMap(indices, [&](int i){
+        changed[i] = frames[i].changedRect(frames[i - 1]);
+    });
+
+    const QImage first = frames[0].getImage();
+    std::vector<PlannedFrame> planned = {{0, first.rect(), frameDuration}};
+    for(int i = 1; i < count; i++)
+    {
+        if(changed[i].isEmpty() && planned.back().delay + frameDuration <= maxDelay)
+        {
+            planned.back().delay += frameDuration;
+            continue;
+        }
+        // A frame that changed nothing but can't be merged still needs a rectangle to show
+        PlannedFrame frame = {i, changed[i].isEmpty() ? QRect(0, 0, 1, 1) : changed[i], frameDuration};
+        planned.push_back(frame);
+    }
+    return planned;
+}
+
+bool ApngEncoder::write(QIODevice& device, const std::vector<Frame>& frames, int frameDuration,
+                        int compressionLevel)
+{
+    if(frames.empty())
+    {
+        return false;
+    }
+    Frame::loadAll(frames);
+
+    frameDuration = qBound(1, frameDuration, maxDelay);
+    const std::vector<PlannedFrame> planned = planFrames(frames, frameDuration);
+    const QImage first = frames[0].getImage();
+
+    QByteArray header(pngSignature, 8);
+    QByteArray ihdr;
+    appendBigEndian32(ihdr, first.width());
+    appendBigEndian32(ihdr, first.height());
+    ihdr.append("\x08\x06\x00\x00\x00", 5);
+    appendChunk(header, "IHDR", ihdr);
+    // Frame count, and 0 plays for looping forever
+    QByteArray actl;
+    appendBigEndian32(actl, (quint32)planned.size());
+    appendBigEndian32(actl, 0);
+    appendChunk(header, "acTL", actl);
+    if(device.write(header) != header.size())
+    {
+        return false;
+    }
+
+    // fcTL and fdAT chunks share one sequence; frame 0's data is in IDAT chunks without one,
+    // so frame i's fcTL is number 2i - 1 and its fdAT 2i
+    std::atomic<bool> encoded{true};
+    bool written = encodeFramesInOrder(device, (int)planned.size(),
+        [&](int i, QByteArray& buffer){
+            const PlannedFrame& frame = planned[i];
+            QByteArray data;
+            if(!imageData(frames[frame.frame].getImage().copy(frame.rect), compressionLevel, data))
+            {
+                encoded = false;
+                return;
+            }
+
+            QByteArray fctl;
+            appendBigEndian32(fctl, i == 0 ? 0 : 2 * i - 1);
+            appendBigEndian32(fctl, frame.rect.width());
+            appendBigEndian32(fctl, frame.rect.height());
+            appendBigEndian32(fctl, frame.rect.x());
+            appendBigEndian32(fctl, frame.rect.y());
+            appendBigEndian16(fctl, (quint16)frame.delay);
+            appendBigEndian16(fctl, 1000);
+            // Dispose none, blend source: the rectangle replaces what is under it and stays
+            fctl.append('\0');
+            fctl.append('\0');
+            appendChunk(buffer, "fcTL", fctl);
+
+            if(i == 0)
+            {
+                appendChunk(buffer, "IDAT", data);
+            }
+            else
+            {
+                QByteArray fdat;
+                fdat.reserve(data.size() + 4);
+                appendBigEndian32(fdat, 2 * i);
+                fdat.append(data);
+                appendChunk(buffer, "fdAT", fdat);
+            }
+        },
+        [](int, const QByteArray&){});
+    if(!written || !encoded)
+    {
+        return false;
+    }
+
+    QByteArray end;
+    appendChunk(end, "IEND", QByteArray());
+    return device.write(end) == end.size();
+}
@@ -0,0 +1,33 @@
+#ifndef APNGENCODER_H
+#define APNGENCODER_H
+
+#include <QIODevice>
+#include <vector>
+#include "frame.h"
+
+/**
+ * @brief ApngEncoder writes the frames of a Sprite as a looping animated PNG, which keeps every
+ * pixel, alpha included, exactly as drawn.
+ *
+ * Frame 0 is the PNG's default image. Every later frame only stores the rectangle that differs
+ * from the frame before it, replacing what is there (blend source, dispose none), and a frame
+ * identical to the one before it isn't stored at all; the one before is shown for longer
+ * instead. Each rectangle is compressed by Qt's PNG writer on the global thread pool, and its
+ * image data is moved into the fcTL/fdAT chunks of the animation in frame order.
+ */
+class ApngEncoder
+{
+public:
+    /**
+     * @brief write encodes the frames as an APNG that loops forever
+     * @param device an open, writable device
+     * @param frames the frames of the Sprite, in order; all the same size
+     * @param frameDuration how long each frame is shown in milliseconds
+     * @param compressionLevel the zlib level from 0, fastest, to 9, smallest; -1 for Qt's default
+     * @return a true/false on whether every frame could be encoded and every byte written
+     */
+    static bool write(QIODevice& device, const std::vector<Frame>& frames, int frameDuration,
+                      int compressionLevel = -1);
+};
+
+#endif // APNGENCODER_H
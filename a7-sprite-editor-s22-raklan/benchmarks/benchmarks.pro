@@ -0,0 +1,27 @@
+QT       += core gui concurrent
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = LeSporkBenchmarks
+
+# The benchmark links the project readers and writers straight from the editor's sources
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    syntheticsprite.cpp \
+    ../frame.cpp \
+    ../jsonproject.cpp \
+    ../pixelscaler.cpp \
+    ../projectfile.cpp
+
+HEADERS += \
+    syntheticsprite.h \
+    ../commonDataTypes.h \
+    ../frame.h \
+    ../jsonproject.h \
+    ../parallelencode.h \
+    ../pixelscaler.h \
+    ../projectfile.h \
+    ../readprogress.h
@@ -0,0 +1,385 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <cstdio>
+#include <vector>
+#include "frame.h"
+#include "projectfile.h"
+#include "jsonproject.h"
+#include "commonDataTypes.h"
+#include "syntheticsprite.h"
+
+/*
+ * Saves and loads synthetic projects in every format the editor can save, printing one JSON
+ * object per line for each combination of format, pattern, frame size and frame count:
+ *
+ *   {"format":"compressed","pattern":"art","size":64,"frames":100,"fileBytes":...,
+ *    "saveMs":...,"loadMs":...,"openMs":...,"savePeakRssKiB":...,"loadPeakRssKiB":...,
+ *    "verified":true}
+ *
+ * Times are the fastest of --repeat runs. loadMs decodes every frame; openMs, for binary
+ * projects only, is what opening in the editor costs: mapping the file and decoding frame 0.
+ * Peak RSS is measured separately for the save and the load, with the generated frames
+ * released before the load starts; it is null where the platform can't reset the peak.
+ * Combinations whose file would be larger than --max-mib are reported as skipped.
+ */
+
+// Compressed saves store a full frame this often, the same interval Model::write uses
+static const int keyframeInterval = 30;
+
+/**
+ * @brief The Format struct names a save format and roughly how many bytes its files take per
+ * byte of pixels, so combinations too large to run can be skipped before they are generated
+ */
+struct Format
+{
+    const char* name;
+    ProjectFormat format;
+    double expansion;
+};
+
+static const Format formats[] = {
+    {"binary", BinaryFormat, 1.0},
+    {"compressed", CompressedBinaryFormat, 1.0},
+    {"json", JsonFormat, 24.0},
+    {"cbor", CborFormat, 1.0},
+    {"msgpack", MessagePackFormat, 1.0},
+    {"hex", JsonHexRowsFormat, 2.1},
+    {"base64", JsonBase64RowsFormat, 1.4}
+};
+
+/**
+ * @brief saveProject writes the frames the way Model::write does for the given format
+ */
+static bool saveProject(QIODevice& device, const std::vector<Frame>& frames, int side, ProjectFormat format)
+{
+    ProjectFile::WriteOptions options;
+    options.usePalette = true;
+    switch(format)
+    {
+        case CompressedBinaryFormat:
+            options.compression = ProjectFile::ZlibChunk;
+            options.keyframeInterval = keyframeInterval;
+            return ProjectFile::write(device, frames, side, side, options);
+        case BinaryFormat:
+            return ProjectFile::write(device, frames, side, side, options);
+        case CborFormat:
+            return JsonProject::write(device, frames, side, side, JsonProject::CborEncoding);
+        case MessagePackFormat:
+            return JsonProject::write(device, frames, side, side, JsonProject::MessagePackEncoding);
+        case JsonHexRowsFormat:
+            return JsonProject::write(device, frames, side, side, JsonProject::HexRowsEncoding);
+        case JsonBase64RowsFormat:
+            return JsonProject::write(device, frames, side, side, JsonProject::Base64RowsEncoding);
+        default:
+            return JsonProject::write(device, frames, side, side);
+    }
+}
+
+/**
+ * @brief resetPeakRss starts a new peak resident set size measurement
+ * @return a true/false on whether the platform supports resetting the peak
+ */
+static bool resetPeakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile clearRefs("/proc/self/clear_refs");
+    return clearRefs.open(QIODevice::WriteOnly) && clearRefs.write("5") == 1;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief peakRss returns the peak resident set size since resetPeakRss in KiB, or -1 if it
+ * can't be read
+ */
+static qint64 peakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile status("/proc/self/status");
+    if(!status.open(QIODevice::ReadOnly))
+    {
+        return -1;
+    }
+    while(!status.atEnd())
+    {
+        QByteArray line = status.readLine();
+        if(line.startsWith("VmHWM:"))
+        {
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+    }
+#endif
+    return -1;
+}
+
+static double elapsedMs(const QElapsedTimer& timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+static std::vector<Frame> generateFrames(SyntheticSprite::Pattern pattern, int side, int count)
+{
+    std::vector<Frame> frames;
+    frames.reserve(count);
+    for(int i = 0; i < count; i++)
+    {
+        frames.push_back(Frame(SyntheticSprite::frame(pattern, side, i)));
+    }
+    return frames;
+}
+
+/**
+ * @brief loadProject reads every frame of the project at filepath
+ */
+static bool loadProject(const QString& filepath, std::vector<Frame>& frames, int& width, int& height)
+{
+    QFile projectFile(filepath);
+    if(!projectFile.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    if(ProjectFile::isBinaryProject(projectFile.peek(4)))
+    {
+        return ProjectFile::read(projectFile, frames, width, height);
+    }
+    return JsonProject::read(projectFile, frames, width, height);
+}
+
+/**
+ * @brief verifyFrames checks loaded frames against freshly generated ones
+ */
+static bool verifyFrames(const std::vector<Frame>& frames, SyntheticSprite::Pattern pattern, int side, int count)
+{
+    if((int)frames.size() != count)
+    {
+        return false;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        if(!frames[i].samePixels(Frame(SyntheticSprite::frame(pattern, side, i))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief runCase saves and loads one synthetic project repeat times and reports the result
+ */
+static QJsonObject runCase(const Format& format, SyntheticSprite::Pattern pattern, int side, int count,
+                           int repeat, const QString& filepath)
+{
+    QJsonObject result;
+    result["format"] = format.name;
+    result["pattern"] = SyntheticSprite::name(pattern);
+    result["size"] = side;
+    result["frames"] = count;
+
+    double saveMs = -1, loadMs = -1, openMs = -1;
+    qint64 savePeak = -1, loadPeak = -1;
+    bool verified = true;
+    for(int run = 0; run < repeat && verified; run++)
+    {
+        {
+            std::vector<Frame> frames = generateFrames(pattern, side, count);
+            bool peakReset = resetPeakRss();
+            QFile projectFile(filepath);
+            QElapsedTimer timer;
+            timer.start();
+            bool saved = projectFile.open(QIODevice::WriteOnly) && saveProject(projectFile, frames, side, format.format);
+            projectFile.close();
+            double ms = elapsedMs(timer);
+            if(!saved)
+            {
+                result["error"] = "save failed";
+                return result;
+            }
+            saveMs = run == 0 ? ms : qMin(saveMs, ms);
+            savePeak = peakReset ? qMax(savePeak, peakRss()) : -1;
+        }
+
+        {
+            std::vector<Frame> frames;
+            int width, height;
+            bool peakReset = resetPeakRss();
+            QElapsedTimer timer;
+            timer.start();
+            bool loaded = loadProject(filepath, frames, width, height);
+            double ms = elapsedMs(timer);
+            loadPeak = peakReset ? qMax(loadPeak, peakRss()) : -1;
+            if(!loaded)
+            {
+                result["error"] = "load failed";
+                return result;
+            }
+            loadMs = run == 0 ? ms : qMin(loadMs, ms);
+            if(run == 0)
+            {
+                verified = width == side && height == side && verifyFrames(frames, pattern, side, count);
+            }
+        }
+
+        if(format.format == BinaryFormat || format.format == CompressedBinaryFormat)
+        {
+            std::vector<Frame> frames;
+            int width, height;
+            QElapsedTimer timer;
+            timer.start();
+            bool opened = ProjectFile::open(filepath, frames, width, height);
+            if(opened)
+            {
+                frames[0].load();
+            }
+            double ms = elapsedMs(timer);
+            openMs = opened ? (run == 0 ? ms : qMin(openMs, ms)) : -1;
+        }
+    }
+
+    result["fileBytes"] = QFile(filepath).size();
+    result["saveMs"] = saveMs;
+    result["loadMs"] = loadMs;
+    result["openMs"] = openMs < 0 ? QJsonValue() : QJsonValue(openMs);
+    result["savePeakRssKiB"] = savePeak < 0 ? QJsonValue() : QJsonValue(savePeak);
+    result["loadPeakRssKiB"] = loadPeak < 0 ? QJsonValue() : QJsonValue(loadPeak);
+    result["verified"] = verified;
+    QFile::remove(filepath);
+    return result;
+}
+
+static void printLine(const QJsonObject& object)
+{
+    QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    std::fwrite(line.constData(), 1, line.size(), stdout);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+}
+
+/**
+ * @brief parseIntList reads a comma separated list of positive integers
+ */
+static bool parseIntList(const QString& text, std::vector<int>& values)
+{
+    values.clear();
+    for(const QString& item : text.split(',', Qt::SkipEmptyParts))
+    {
+        bool ok;
+        int value = item.trimmed().toInt(&ok);
+        if(!ok || value <= 0)
+        {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("LeSporkBenchmarks");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times saving and loading synthetic Sprites in every project format, "
+                                     "printing one JSON object per line.");
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes", "Comma separated frame sizes in pixels.", "list",
+                                   "8,16,32,64,128,256,512,1024");
+    QCommandLineOption framesOption("frames", "Comma separated frame counts.", "list", "1,10,100,500,2000");
+    QCommandLineOption patternsOption("patterns", "Comma separated patterns: noise, flat, art.", "list",
+                                      "noise,flat,art");
+    QCommandLineOption formatsOption("formats", "Comma separated formats: binary, compressed, json, cbor, "
+                                     "msgpack, hex, base64.", "list",
+                                     "binary,compressed,json,cbor,msgpack,hex,base64");
+    QCommandLineOption repeatOption("repeat", "Runs per combination; the fastest is reported.", "n", "3");
+    QCommandLineOption maxOption("max-mib", "Skip combinations whose file would exceed this many MiB.", "mib", "256");
+    QCommandLineOption dirOption("dir", "Directory for the project files, a temporary one by default.", "path");
+    parser.addOptions({sizesOption, framesOption, patternsOption, formatsOption, repeatOption, maxOption, dirOption});
+    parser.process(app);
+
+    std::vector<int> sizes, counts;
+    if(!parseIntList(parser.value(sizesOption), sizes) || !parseIntList(parser.value(framesOption), counts))
+    {
+        qCritical("Sizes and frame counts must be comma separated positive integers.");
+        return 1;
+    }
+    std::vector<SyntheticSprite::Pattern> patterns;
+    for(const QString& name : parser.value(patternsOption).split(',', Qt::SkipEmptyParts))
+    {
+        SyntheticSprite::Pattern pattern;
+        if(!SyntheticSprite::parse(name.trimmed(), pattern))
+        {
+            qCritical("Unknown pattern %s.", qPrintable(name));
+            return 1;
+        }
+        patterns.push_back(pattern);
+    }
+    std::vector<const Format*> selectedFormats;
+    for(const QString& name : parser.value(formatsOption).split(',', Qt::SkipEmptyParts))
+    {
+        const Format* found = nullptr;
+        for(const Format& format : formats)
+        {
+            if(name.trimmed() == format.name)
+            {
+                found = &format;
+            }
+        }
+        if(!found)
+        {
+            qCritical("Unknown format %s.", qPrintable(name));
+            return 1;
+        }
+        selectedFormats.push_back(found);
+    }
+    int repeat = qMax(1, parser.value(repeatOption).toInt());
+    double maxBytes = parser.value(maxOption).toDouble() * 1024 * 1024;
+
+    QTemporaryDir temporaryDir;
+    QString dir = parser.isSet(dirOption) ? parser.value(dirOption) : temporaryDir.path();
+    QString filepath = dir + "/benchmark.ssp";
+
+    QJsonObject environment;
+    environment["benchmark"] = "LeSporkBenchmarks";
+    environment["qt"] = qVersion();
+    environment["threads"] = QThreadPool::globalInstance()->maxThreadCount();
+    environment["repeat"] = repeat;
+    printLine(environment);
+
+    bool allVerified = true;
+    for(const Format* format : selectedFormats)
+    {
+        for(SyntheticSprite::Pattern pattern : patterns)
+        {
+            for(int side : sizes)
+            {
+                for(int count : counts)
+                {
+                    double estimatedBytes = (double)side * side * 4 * count * format->expansion;
+                    if(estimatedBytes > maxBytes)
+                    {
+                        QJsonObject skipped;
+                        skipped["format"] = format->name;
+                        skipped["pattern"] = SyntheticSprite::name(pattern);
+                        skipped["size"] = side;
+                        skipped["frames"] = count;
+                        skipped["skipped"] = "larger than --max-mib";
+                        printLine(skipped);
+                        continue;
+                    }
+                    QJsonObject result = runCase(*format, pattern, side, count, repeat, filepath);
+                    allVerified = allVerified && !result.contains("error") && result["verified"].toBool();
+                    printLine(result);
+                }
+            }
+        }
+    }
+    return allVerified ? 0 : 1;
+}
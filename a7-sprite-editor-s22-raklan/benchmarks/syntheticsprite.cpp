@@ -0,0 +1,133 @@
+#include "syntheticsprite.h"
+#include <algorithm>
+
+// A small pixel art palette; the art pattern only ever uses these colors
+static const QRgb artPalette[16] = {
+    0xff1a1c2c, 0xff5d275d, 0xffb13e53, 0xffef7d57,
+    0xffffcd75, 0xffa7f070, 0xff38b764, 0xff257179,
+    0xff29366f, 0xff3b5dc9, 0xff41a6f6, 0xff73eff7,
+    0xfff4f4f4, 0xff94b0c2, 0xff566c86, 0xff333c57
+};
+
+/**
+ * @brief xorshift advances a 32-bit xorshift generator; cheap enough that generating noise
+ * never dominates a benchmark
+ */
+static quint32 xorshift(quint32& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void fillNoise(QImage& image, int index)
+{
+    quint32 state = 2463534242u ^ (quint32)(index * 2654435761u);
+    for(int y = 0; y < image.height(); y++)
+    {
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x = 0; x < image.width(); x++)
+        {
+            row[x] = xorshift(state);
+        }
+    }
+}
+
+static void fillArt(QImage& image, int index)
+{
+    const int side = image.width();
+    // Each drawing is held for two frames
+    const int time = index / 2;
+
+    // Sky, hills and ground as horizontal bands
+    for(int y = 0; y < side; y++)
+    {
+        QRgb color = artPalette[8 + (y * 4 / side)];
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x = 0; x < side; x++)
+        {
+            row[x] = color;
+        }
+    }
+
+    // A ball that crosses the frame, with a one pixel outline
+    const int radius = std::max(1, side / 6);
+    const int centerX = (time * std::max(1, side / 32)) % (side + 2 * radius) - radius;
+    const int centerY = side / 2 + ((time % 8) < 4 ? time % 4 : 4 - time % 4) * side / 64;
+    for(int y = std::max(0, centerY - radius - 1); y < std::min(side, centerY + radius + 2); y++)
+    {
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x = std::max(0, centerX - radius - 1); x < std::min(side, centerX + radius + 2); x++)
+        {
+            int distance = (x - centerX) * (x - centerX) + (y - centerY) * (y - centerY);
+            if(distance <= radius * radius)
+            {
+                row[x] = artPalette[2 + (x + y) % 2 * (distance < radius * radius / 4)];
+            }
+            else if(distance <= (radius + 1) * (radius + 1))
+            {
+                row[x] = artPalette[0];
+            }
+        }
+    }
+
+    // A blinking sign in the corner
+    if(time % 6 < 3)
+    {
+        const int sign = std::max(1, side / 8);
+        for(int y = 0; y < sign; y++)
+        {
+            QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for(int x = side - sign; x < side; x++)
+            {
+                row[x] = artPalette[4 + (x / 2 + y / 2) % 2];
+            }
+        }
+    }
+}
+
+QImage SyntheticSprite::frame(Pattern pattern, int side, int index)
+{
+    QImage image(side, side, QImage::Format_ARGB32);
+    switch(pattern)
+    {
+        case NoisePattern:
+            fillNoise(image, index);
+            break;
+        case FlatPattern:
+            image.fill(artPalette[10]);
+            break;
+        case ArtPattern:
+            fillArt(image, index);
+            break;
+    }
+    return image;
+}
+
+QString SyntheticSprite::name(Pattern pattern)
+{
+    switch(pattern)
+    {
+        case NoisePattern:
+            return "noise";
+        case FlatPattern:
+            return "flat";
+        case ArtPattern:
+            return "art";
+    }
+    return QString();
+}
+
+bool SyntheticSprite::parse(const QString& patternName, Pattern& pattern)
+{
+    for(Pattern candidate : {NoisePattern, FlatPattern, ArtPattern})
+    {
+        if(name(candidate) == patternName)
+        {
+            pattern = candidate;
+            return true;
+        }
+    }
+    return false;
+}
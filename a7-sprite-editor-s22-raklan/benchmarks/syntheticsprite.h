@@ -0,0 +1,52 @@
+#ifndef SYNTHETICSPRITE_H
+#define SYNTHETICSPRITE_H
+
+#include <QImage>
+#include <QString>
+
+/**
+ * @brief SyntheticSprite generates the frames of the projects the benchmarks save and load.
+ * Every frame is a pure function of the pattern, size and frame index, so a loaded project can
+ * be checked against freshly generated frames without keeping the originals in memory
+ */
+class SyntheticSprite
+{
+public:
+    /**
+     * @brief The Pattern enum selects what the frames look like, from the worst case for every
+     * encoder to the best
+     */
+    enum Pattern{
+        // Every pixel random, alpha included; nothing compresses, deltas or palettes
+        NoisePattern,
+        // Every pixel of every frame the same color
+        FlatPattern,
+        // A 16 color scene of bands and shapes that move a little each frame, every frame
+        // shown twice, like hand drawn animation
+        ArtPattern
+    };
+
+    /**
+     * @brief frame generates one frame of a synthetic project
+     * @param pattern what the frame looks like
+     * @param side the width and height of the frame in pixels
+     * @param index the index of the frame in the project
+     * @return a side by side ARGB32 image
+     */
+    static QImage frame(Pattern pattern, int side, int index);
+
+    /**
+     * @brief name returns the name a pattern is given on the command line and in results
+     */
+    static QString name(Pattern pattern);
+
+    /**
+     * @brief parse looks up a pattern by its name
+     * @param name the name as returned by name()
+     * @param pattern set to the matching pattern
+     * @return a true/false on whether the name matched a pattern
+     */
+    static bool parse(const QString& name, Pattern& pattern);
+};
+
+#endif // SYNTHETICSPRITE_H
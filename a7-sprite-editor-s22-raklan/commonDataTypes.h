@@ -29,4 +29,18 @@ enum UIButton{
     ClearFrameButton
 };
 
+/**
+ * @brief The ProjectFormat enum defines each of the file formats
+ * a Sprite project can be saved as.
+ */
+enum ProjectFormat{
+    BinaryFormat,
+    CompressedBinaryFormat,
+    JsonFormat,
+    CborFormat,
+    MessagePackFormat,
+    JsonHexRowsFormat,
+    JsonBase64RowsFormat
+};
+
 #endif // COMMONDATATYPES_H
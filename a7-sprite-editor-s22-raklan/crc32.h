@@ -0,0 +1,33 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <QtGlobal>
+#include <vector>
+
+/**
+ * @brief crc32 computes the CRC-32 used by zlib and PNG, continuing from a previous result
+ */
+inline quint32 crc32(const uchar* data, qint64 size, quint32 crc = 0)
+{
+    static const std::vector<quint32> table = [](){
+        std::vector<quint32> entries(256);
+        for(quint32 n = 0; n < 256; n++)
+        {
+            quint32 c = n;
+            for(int bit = 0; bit < 8; bit++)
+            {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    crc = ~crc;
+    for(qint64 i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#endif // CRC32_H
@@ -0,0 +1,244 @@
+#include "engineexport.h"
+#include "parallelencode.h"
+#include <QSet>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const char engineMagic[4] = {'S', 'S', 'P', 'R'};
+// The first frame starts on a cache line, and every frame on a 16-byte boundary
+static const int dataAlignment = 64;
+static const int frameAlignment = 16;
+static const int maxPaletteColors = 256;
+
+static quint64 alignUp(quint64 value, quint64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief toRgba8888 swaps the red and blue bytes of each pixel, as ARGB32 is B, G, R, A in
+ * memory on the little-endian CPUs the vector path runs on
+ */
+static void toRgba8888(const QRgb* pixels, int count, uchar* out)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i greenAlpha = _mm_set1_epi32((int)0xff00ff00);
+    const __m128i lowByte = _mm_set1_epi32(0xff);
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128i p = _mm_loadu_si128((const __m128i*)(pixels + i));
+        const __m128i red = _mm_and_si128(_mm_srli_epi32(p, 16), lowByte);
+        const __m128i blue = _mm_slli_epi32(_mm_and_si128(p, lowByte), 16);
+        _mm_storeu_si128((__m128i*)(out + i * 4), _mm_or_si128(_mm_and_si128(p, greenAlpha), _mm_or_si128(red, blue)));
+    }
+#endif
+    for(; i < count; i++)
+    {
+        out[i * 4] = (uchar)qRed(pixels[i]);
+        out[i * 4 + 1] = (uchar)qGreen(pixels[i]);
+        out[i * 4 + 2] = (uchar)qBlue(pixels[i]);
+        out[i * 4 + 3] = (uchar)qAlpha(pixels[i]);
+    }
+}
+
+/**
+ * @brief toRgb565 keeps the top 5, 6 and 5 bits of red, green and blue of each pixel
+ */
+static void toRgb565(const QRgb* pixels, int count, uchar* out)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i redMask = _mm_set1_epi32(0xf800);
+    const __m128i greenMask = _mm_set1_epi32(0x07e0);
+    const __m128i blueMask = _mm_set1_epi32(0x001f);
+    auto pack = [&](__m128i p){
+        const __m128i packed = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), redMask),
+                                            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 5), greenMask),
+                                                         _mm_and_si128(_mm_srli_epi32(p, 3), blueMask)));
+        // Sign extend the low 16 bits so narrowing with signed saturation keeps them as they are
+        return _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+    };
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i first = pack(_mm_loadu_si128((const __m128i*)(pixels + i)));
+        const __m128i second = pack(_mm_loadu_si128((const __m128i*)(pixels + i + 4)));
+        _mm_storeu_si128((__m128i*)(out + i * 2), _mm_packs_epi32(first, second));
+    }
+#endif
+    for(; i < count; i++)
+    {
+        const quint16 pixel = (quint16)((qRed(pixels[i]) >> 3) << 11 | (qGreen(pixels[i]) >> 2) << 5 | qBlue(pixels[i]) >> 3);
+        qToLittleEndian<quint16>(pixel, out + i * 2);
+    }
+}
+
+void EngineExport::convertPixels(const QRgb* pixels, int count, PixelFormat format, uchar* out)
+{
+    if(format == Rgb565)
+    {
+        toRgb565(pixels, count, out);
+    }
+    else
+    {
+        toRgba8888(pixels, count, out);
+    }
+}
+
+int EngineExport::bytesPerPixel(PixelFormat format)
+{
+    switch(format)
+    {
+    case Rgba8888:
+        return 4;
+    case Rgb565:
+        return 2;
+    case Indexed8:
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief collectPalette gathers the distinct colors of every frame, sorted
+ * @return a true/false on whether there are few enough to index with a byte
+ */
+static bool collectPalette(const std::vector<QImage>& images, std::vector<QRgb>& palette)
+{
+    std::vector<QSet<QRgb>> colors(images.size());
+    std::vector<int> indices(images.size());
+    for(int i = 0; i < (int)images.size(); i++)
+    {
+        indices[i] = i;
+    }
+    QtConcurrent::blockingMap(indices, [&](int i){
+        const QRgb* pixels = (const QRgb*)images[i].constBits();
+        const qsizetype count = (qsizetype)images[i].width() * images[i].height();
+        QRgb last = 0;
+        for(qsizetype p = 0; p < count && colors[i].size() <= maxPaletteColors; p++)
+        {
+            // Pixel art comes in runs, so most pixels repeat the one before
+            if(p == 0 || pixels[p] != last)
+            {
+                last = pixels[p];
+                colors[i].insert(last);
+            }
+        }
+    });
+
+    QSet<QRgb> all;
+    for(const QSet<QRgb>& frameColors : colors)
+    {
+        all.unite(frameColors);
+        if(all.size() > maxPaletteColors)
+        {
+            return false;
+        }
+    }
+    palette.assign(all.begin(), all.end());
+    std::sort(palette.begin(), palette.end());
+    return true;
+}
+
+/**
+ * @brief toIndices looks each pixel up in the sorted palette
+ */
+static void toIndices(const QRgb* pixels, qsizetype count, const std::vector<QRgb>& palette, uchar* out)
+{
+    QRgb last = pixels[0];
+    uchar lastIndex = (uchar)(std::lower_bound(palette.begin(), palette.end(), last) - palette.begin());
+    for(qsizetype p = 0; p < count; p++)
+    {
+        if(pixels[p] != last)
+        {
+            last = pixels[p];
+            lastIndex = (uchar)(std::lower_bound(palette.begin(), palette.end(), last) - palette.begin());
+        }
+        out[p] = lastIndex;
+    }
+}
+
+bool EngineExport::write(QIODevice& device, const std::vector<Frame>& frames, PixelFormat format)
+{
+    if(frames.empty() || bytesPerPixel(format) == 0)
+    {
+        return false;
+    }
+    Frame::loadAll(frames);
+
+    // ARGB32 rows are whole 32-bit words with no padding between them, so a frame is
+    // converted as one run of pixels
+    const int count = (int)frames.size();
+    std::vector<QImage> images(count);
+    std::vector<int> indices(count);
+    for(int i = 0; i < count; i++)
+    {
+        images[i] = frames[i].getImage();
+        if(images[i].format() != QImage::Format_ARGB32)
+        {
+            images[i] = images[i].convertToFormat(QImage::Format_ARGB32);
+        }
+        indices[i] = i;
+    }
+    const int width = images[0].width();
+    const int height = images[0].height();
+    const qsizetype pixelCount = (qsizetype)width * height;
+
+    std::vector<QRgb> palette;
+    if(format == Indexed8 && !collectPalette(images, palette))
+    {
+        qWarning("The frames use more than 256 colors, too many to index.");
+        return false;
+    }
+
+    const quint32 frameSize = (quint32)(pixelCount * bytesPerPixel(format));
+    const quint32 frameStride = (quint32)alignUp(frameSize, frameAlignment);
+    const quint32 paletteOffset = palette.empty() ? 0 : headerSize;
+    const quint64 dataOffset = alignUp(headerSize + palette.size() * 4, dataAlignment);
+
+    QByteArray header(dataOffset, '\0');
+    uchar* h = (uchar*)header.data();
+    memcpy(h, engineMagic, 4);
+    qToLittleEndian<quint16>(currentVersion, h + 4);
+    qToLittleEndian<quint16>(headerSize, h + 6);
+    qToLittleEndian<quint32>(width, h + 8);
+    qToLittleEndian<quint32>(height, h + 12);
+    qToLittleEndian<quint32>(count, h + 16);
+    qToLittleEndian<quint16>(format, h + 20);
+    qToLittleEndian<quint16>(bytesPerPixel(format), h + 22);
+    qToLittleEndian<quint32>(frameSize, h + 24);
+    qToLittleEndian<quint32>(frameStride, h + 28);
+    qToLittleEndian<quint32>(paletteOffset, h + 32);
+    qToLittleEndian<quint32>((quint32)palette.size(), h + 36);
+    qToLittleEndian<quint64>(dataOffset, h + 40);
+    if(!palette.empty())
+    {
+        toRgba8888(palette.data(), (int)palette.size(), h + paletteOffset);
+    }
+    if(device.write(header) != header.size())
+    {
+        return false;
+    }
+
+    return encodeFramesInOrder(device, count,
+        [&](int i, QByteArray& buffer){
+            buffer.fill('\0', frameStride);
+            const QRgb* pixels = (const QRgb*)images[i].constBits();
+            uchar* out = (uchar*)buffer.data();
+            if(format == Indexed8)
+            {
+                toIndices(pixels, pixelCount, palette, out);
+            }
+            else
+            {
+                convertPixels(pixels, (int)pixelCount, format, out);
+            }
+        },
+        [](int, const QByteArray&){});
+}
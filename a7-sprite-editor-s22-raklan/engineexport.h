@@ -0,0 +1,67 @@
+#ifndef ENGINEEXPORT_H
+#define ENGINEEXPORT_H
+
+#include <QIODevice>
+#include <QImage>
+#include <vector>
+#include "frame.h"
+
+/**
+ * @brief EngineExport writes frames as one uncompressed blob in the pixel layouts game engines
+ * upload straight to textures, laid out so the file can be mapped into memory and used in
+ * place. All integers are little-endian and the file is laid out as:
+ *
+ *   Header   48 bytes: magic "SSPR", version, header size, width, height, frame count,
+ *            pixel format, bytes per pixel, frame size, frame stride, palette offset,
+ *            palette size, offset of the first frame
+ *   Palette  4 bytes per color as R, G, B, A; only for Indexed8
+ *   Frames   frame stride bytes each, starting at a multiple of 64
+ *
+ * A frame is its rows top to bottom with no padding between them, so it is width * height *
+ * bytes per pixel long. The frame stride rounds that up to a multiple of 16, so every frame
+ * starts aligned for vector loads; frame i is at the first frame's offset + i * frame stride.
+ */
+class EngineExport
+{
+public:
+    /**
+     * @brief The PixelFormat enum selects how each pixel is stored
+     */
+    enum PixelFormat{
+        // 4 bytes: R, G, B, A
+        Rgba8888 = 1,
+        // 16 bits: red in the top 5, green in the middle 6, blue in the low 5; alpha is dropped
+        Rgb565 = 2,
+        // 1 byte: an index into the palette; the frames must use 256 colors or fewer
+        Indexed8 = 3
+    };
+
+    static const quint16 currentVersion = 1;
+    static const quint16 headerSize = 48;
+
+    /**
+     * @brief write converts the frames and writes them with their header
+     * @param device an open, writable device
+     * @param frames the frames to write, in order; all the same size
+     * @param format how each pixel is stored
+     * @return a true/false on whether the frames fit the format and every byte was written
+     */
+    static bool write(QIODevice& device, const std::vector<Frame>& frames, PixelFormat format);
+
+    /**
+     * @brief bytesPerPixel returns the size of a pixel in a format
+     */
+    static int bytesPerPixel(PixelFormat format);
+
+    /**
+     * @brief convertPixels converts ARGB32 pixels to Rgba8888 or Rgb565, several pixels at a
+     * time where the CPU has vector instructions
+     * @param pixels the pixels to convert
+     * @param count the number of pixels
+     * @param format Rgba8888 or Rgb565
+     * @param out receives count * bytesPerPixel(format) bytes
+     */
+    static void convertPixels(const QRgb* pixels, int count, PixelFormat format, uchar* out);
+};
+
+#endif // ENGINEEXPORT_H
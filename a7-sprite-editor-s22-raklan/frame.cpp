@@ -1,5 +1,12 @@
 #include "frame.h"
+#include "pixelscaler.h"
 #include <QtDebug>
+#include <QtEndian>
+#include <QtConcurrent>
+#include <QFile>
+#include <QFileInfo>
+#include <cctype>
+#include <cstring>
 
 Frame::Frame(int width, int height)
     :image(width, height, QImage::Format_ARGB32)
@@ -7,83 +14,763 @@ Frame::Frame(int width, int height)
     image.fill(0);
 }
 
+Frame::Frame(const QImage& _image)
+    :image(_image.format() == QImage::Format_ARGB32 ? _image : _image.convertToFormat(QImage::Format_ARGB32))
+{
+}
+
+Frame::Frame(std::function<QImage()> _loader)
+    :loader(std::move(_loader))
+{
+}
+
+void Frame::materialize() const
+{
+    if(loader)
+    {
+        image = loader();
+        if(image.format() != QImage::Format_ARGB32)
+        {
+            image = image.convertToFormat(QImage::Format_ARGB32);
+        }
+        loader = nullptr;
+    }
+}
+
+bool Frame::isLoaded() const
+{
+    return !loader;
+}
+
+void Frame::load() const
+{
+    materialize();
+}
+
+void Frame::loadAll(const std::vector<Frame>& frames)
+{
+    std::vector<const Frame*> pending;
+    for(const Frame& frame : frames)
+    {
+        if(!frame.isLoaded())
+        {
+            pending.push_back(&frame);
+        }
+    }
+    QtConcurrent::blockingMap(pending, [](const Frame* frame){
+        frame->load();
+    });
+}
+
 void Frame::setPixel(int x, int y, QColor color)
 {
+    materialize();
     image.setPixel(x,y,color.rgba());
 }
 
 QColor Frame::getPixel(int x, int y)
 {
+    materialize();
     return image.pixelColor(x,y);
 }
 
-QImage Frame::getImage()
+QImage Frame::getImage() const
 {
+    materialize();
     return image;
 }
 
 QPixmap Frame::getPixMap()
 {
+    materialize();
     return QPixmap::fromImage(image);
 }
 
+/**
+ * @brief DecimalDigits holds the decimal text of every byte value, so the text exports look a
+ * channel up instead of formatting it
+ */
+struct DecimalDigits
+{
+    char text[256][3];
+    int length[256];
+
+    DecimalDigits()
+    {
+        for(int value = 0; value < 256; value++)
+        {
+            int digits = value >= 100 ? 3 : value >= 10 ? 2 : 1;
+            for(int i = digits - 1, rest = value; i >= 0; i--, rest /= 10)
+            {
+                text[value][i] = '0' + rest % 10;
+            }
+            length[value] = digits;
+        }
+    }
+
+    /**
+     * @brief rowLength returns how many digits the channels of a row of pixels take
+     */
+    qsizetype rowLength(const QRgb* row, int width) const
+    {
+        qsizetype digits = 0;
+        for(int w = 0; w < width; w++)
+        {
+            const QRgb pixel = row[w];
+            digits += length[qRed(pixel)] + length[qGreen(pixel)] + length[qBlue(pixel)] + length[qAlpha(pixel)];
+        }
+        return digits;
+    }
+
+    /**
+     * @brief append copies the digits of value to out followed by separator
+     */
+    char* append(char* out, int value, const char* separator, int separatorLength) const
+    {
+        memcpy(out, text[value], length[value]);
+        out += length[value];
+        memcpy(out, separator, separatorLength);
+        return out + separatorLength;
+    }
+};
+
+static const DecimalDigits& decimalDigits()
+{
+    static const DecimalDigits digits;
+    return digits;
+}
+
+// Every pixel of frameAsString is "{ r, g, b, a, }", pixels are separated by ", ", each row
+// starts with "{ " and rows are separated by ", \n"
+static const int textPixelLength = 11;
+
+static qsizetype textRowLength(const QRgb* row, int width, bool lastRow)
+{
+    return 2 + decimalDigits().rowLength(row, width) + (qsizetype)width * textPixelLength
+            + (qsizetype)(width - 1) * 2 + (lastRow ? 0 : 3);
+}
+
+static char* appendTextRow(char* out, const QRgb* row, int width, bool lastRow)
+{
+    const DecimalDigits& digits = decimalDigits();
+    *out++ = '{';
+    *out++ = ' ';
+    for(int w = 0; w < width; w++)
+    {
+        const QRgb pixel = row[w];
+        *out++ = '{';
+        *out++ = ' ';
+        out = digits.append(out, qRed(pixel), ", ", 2);
+        out = digits.append(out, qGreen(pixel), ", ", 2);
+        out = digits.append(out, qBlue(pixel), ", ", 2);
+        out = digits.append(out, qAlpha(pixel), ", }", 3);
+        if(w != width - 1)
+        {
+            *out++ = ',';
+            *out++ = ' ';
+        }
+    }
+    if(!lastRow)
+    {
+        memcpy(out, ", \n", 3);
+        out += 3;
+    }
+    return out;
+}
+
 std::string Frame::frameAsString()
 {
-   std::string result;
-   for(int h =0; h < image.height(); h++)
-   {
-       result.append("{ ");
-       for(int w =0; w < image.width(); w++)
-       {
-           char pixel [23];
-           QColor pColor = image.pixelColor(w,h);
-           sprintf (pixel, "{ %d, %d, %d, %d, }", pColor.red(), pColor.green(), pColor.blue(), pColor.alpha());
-           result.append(pixel);
-           if(w != image.width() -1)
-           {
-               result.append(", ");
-           }
-       }
-       if(h != image.height() -1)
-       {
-           result.append(", \n");
-       }
-   }
-   return  result;
+    materialize();
+    const int width = image.width();
+    const int height = image.height();
+
+    qsizetype length = 0;
+    for(int h = 0; h < height; h++)
+    {
+        length += textRowLength((const QRgb*)image.constScanLine(h), width, h == height - 1);
+    }
+
+    std::string result(length, '\0');
+    char* out = &result[0];
+    for(int h = 0; h < height; h++)
+    {
+        out = appendTextRow(out, (const QRgb*)image.constScanLine(h), width, h == height - 1);
+    }
+    return result;
+}
+
+bool Frame::exportText(QString fileName)
+{
+    materialize();
+    QFile textFile(fileName);
+    if(!textFile.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    const int width = image.width();
+    const int height = image.height();
+    QByteArray buffer;
+    for(int h = 0; h < height; h++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(h);
+        buffer.resize(textRowLength(row, width, h == height - 1));
+        appendTextRow(buffer.data(), row, width, h == height - 1);
+        if(textFile.write(buffer) != buffer.size())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief headerIdentifier turns a file name into a C identifier: anything but letters, digits
+ * and underscores becomes an underscore, and a name that doesn't start with a letter is
+ * prefixed with "sprite_" so it never collides with the names reserved for the implementation
+ */
+static QByteArray headerIdentifier(const QString& fileName)
+{
+    QByteArray name = QFileInfo(fileName).completeBaseName().toLatin1();
+    for(char& c : name)
+    {
+        if(!isalnum((uchar)c) && c != '_')
+        {
+            c = '_';
+        }
+    }
+    if(name.isEmpty())
+    {
+        name = "sprite";
+    }
+    else if(!isalpha((uchar)name[0]))
+    {
+        name.prepend("sprite_");
+    }
+    return name;
+}
+
+bool Frame::exportHeader(QString fileName)
+{
+    materialize();
+    QFile headerFile(fileName);
+    if(!headerFile.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    const int width = image.width();
+    const int height = image.height();
+    const QByteArray name = headerIdentifier(fileName);
+    const QByteArray guard = name.toUpper() + "_H";
+    const QByteArray qualifier = name.toUpper() + "_CONSTEXPR";
+    const QByteArray size = QByteArray::number(width) + " * " + QByteArray::number(height) + " * 4";
+
+    QByteArray text;
+    text += "// " + QByteArray::number(width) + "x" + QByteArray::number(height) + " sprite frame exported by LeSporkEditor\n";
+    text += "#ifndef " + guard + "\n#define " + guard + "\n\n";
+    text += "#include <stdint.h>\n\n";
+    text += "#ifdef __cplusplus\n#define " + qualifier + " constexpr\n#else\n#define " + qualifier + " const\n#endif\n\n";
+    text += "static " + qualifier + " int " + name + "_width = " + QByteArray::number(width) + ";\n";
+    text += "static " + qualifier + " int " + name + "_height = " + QByteArray::number(height) + ";\n\n";
+    text += "// r, g, b, a bytes, one row of pixels per line\n";
+    text += "static " + qualifier + " uint8_t " + name + "_pixels[" + size + "] = {\n";
+    if(headerFile.write(text) != text.size())
+    {
+        return false;
+    }
+
+    // Each row is indented and every channel is followed by ", ", or ",\n" at the end of the row
+    const DecimalDigits& digits = decimalDigits();
+    for(int h = 0; h < height; h++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(h);
+        text.resize(4 + digits.rowLength(row, width) + (qsizetype)width * 8);
+        char* out = text.data();
+        memset(out, ' ', 4);
+        out += 4;
+        for(int w = 0; w < width; w++)
+        {
+            const QRgb pixel = row[w];
+            out = digits.append(out, qRed(pixel), ", ", 2);
+            out = digits.append(out, qGreen(pixel), ", ", 2);
+            out = digits.append(out, qBlue(pixel), ", ", 2);
+            out = digits.append(out, qAlpha(pixel), w != width - 1 ? ", " : ",\n", 2);
+        }
+        if(headerFile.write(text) != text.size())
+        {
+            return false;
+        }
+    }
+
+    text = "};\n\n#endif // " + guard + "\n";
+    return headerFile.write(text) == text.size();
 }
 
 bool Frame::operator==(const Frame& rhs)
 {
+    materialize();
+    rhs.materialize();
     return image == rhs.image;
 }
 
-bool Frame::exportPNG(QString fileName)
+QRect Frame::changedRect(const Frame& previous) const
+{
+    materialize();
+    previous.materialize();
+    const int width = image.width();
+    int top = -1;
+    int bottom = -1;
+    int left = width;
+    int right = -1;
+    for(int h = 0; h < image.height(); h++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(h);
+        const QRgb* previousRow = (const QRgb*)previous.image.constScanLine(h);
+        if(memcmp(row, previousRow, width * 4) == 0)
+        {
+            continue;
+        }
+        if(top < 0)
+        {
+            top = h;
+        }
+        bottom = h;
+        int w = 0;
+        while(row[w] == previousRow[w])
+        {
+            w++;
+        }
+        left = std::min(left, w);
+        w = width - 1;
+        while(row[w] == previousRow[w])
+        {
+            w--;
+        }
+        right = std::max(right, w);
+    }
+    if(top < 0)
+    {
+        return QRect();
+    }
+    return QRect(left, top, right - left + 1, bottom - top + 1);
+}
+
+size_t Frame::contentHash() const
 {
-    return image.save(fileName, "PNG");
+    materialize();
+    size_t hash = ((size_t)image.width() << 16) ^ (size_t)image.height();
+    for(int h = 0; h < image.height(); h++)
+    {
+        hash = qHashBits(image.constScanLine(h), image.width() * 4, hash);
+    }
+    return hash;
 }
 
-void Frame::write(QJsonObject &json, int frameNum) const
+bool Frame::samePixels(const Frame& other) const
 {
-    QJsonArray pixelRowsArray;
-    for(int h =0; h < image.height(); h++)
+    materialize();
+    other.materialize();
+    if(image.size() != other.image.size())
     {
-        QJsonArray pixelsArray;
-        for(int w =0; w < image.width(); w++)
+        return false;
+    }
+    // Frames that share one image, as duplicates do after loading, match without comparing
+    if(image.constBits() == other.image.constBits())
+    {
+        return true;
+    }
+    for(int h = 0; h < image.height(); h++)
+    {
+        if(memcmp(image.constScanLine(h), other.image.constScanLine(h), image.width() * 4) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frame::exportPNG(QString fileName, int compressionLevel, int scale)
+{
+    materialize();
+    return PixelScaler::scale(image, scale).save(fileName, "PNG", pngQuality(compressionLevel));
+}
+
+int Frame::pngQuality(int compressionLevel)
+{
+    if(compressionLevel < 0)
+    {
+        return -1;
+    }
+    // Qt's PNG writer takes a quality and uses zlib level (100 - quality) * 9 / 91; this is the
+    // highest quality that still maps to the requested level
+    return 100 - (qMin(compressionLevel, 9) * 91 + 8) / 9;
+}
+
+/**
+ * @brief ChannelLine is one channel of a pixel as it appears in a saved file: indented to
+ * the depth of a pixel's channels in the .ssp schema and followed by ",\n"
+ */
+struct ChannelLine
+{
+    char text[28];
+    int length;
+};
+
+// Indentation of the pieces of a frame inside the .ssp document
+static const int rowIndent = 12;
+static const int pixelIndent = 16;
+static const int channelIndent = 20;
+
+static const ChannelLine* channelLines()
+{
+    static ChannelLine lines[256];
+    static bool built = [](){
+        for(int value = 0; value < 256; value++)
+        {
+            ChannelLine& line = lines[value];
+            memset(line.text, ' ', channelIndent);
+            line.length = channelIndent + sprintf(line.text + channelIndent, "%d,\n", value);
+        }
+        return true;
+    }();
+    (void)built;
+    return lines;
+}
+
+static char* appendIndented(char* out, int indent, const char* text, int length)
+{
+    memset(out, ' ', indent);
+    memcpy(out + indent, text, length);
+    return out + indent + length;
+}
+
+void Frame::write(QByteArray& buffer) const
+{
+    materialize();
+    const ChannelLine* lines = channelLines();
+    const int width = image.width();
+    const int height = image.height();
+
+    // Worst case per pixel is its brackets plus four three-digit channels
+    const qsizetype pixelBound = (pixelIndent + 3) * 2 + (channelIndent + 5) * 4;
+    const qsizetype bound = rowIndent + 4 + (qsizetype)height * ((rowIndent + 3) * 2 + width * pixelBound);
+    const qsizetype start = buffer.size();
+    buffer.resize(start + bound);
+    char* out = buffer.data() + start;
+
+    *out++ = '[';
+    *out++ = '\n';
+    for(int h = 0; h < height; h++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(h);
+        out = appendIndented(out, rowIndent, "[\n", 2);
+        for(int w = 0; w < width; w++)
+        {
+            const QRgb pixel = row[w];
+            const ChannelLine& red = lines[qRed(pixel)];
+            const ChannelLine& green = lines[qGreen(pixel)];
+            const ChannelLine& blue = lines[qBlue(pixel)];
+            const ChannelLine& alpha = lines[qAlpha(pixel)];
+
+            out = appendIndented(out, pixelIndent, "[\n", 2);
+            memcpy(out, red.text, red.length);
+            out += red.length;
+            memcpy(out, green.text, green.length);
+            out += green.length;
+            memcpy(out, blue.text, blue.length);
+            out += blue.length;
+            // The last channel drops the comma
+            memcpy(out, alpha.text, alpha.length - 2);
+            out += alpha.length - 2;
+            *out++ = '\n';
+            out = appendIndented(out, pixelIndent, w != width - 1 ? "],\n" : "]\n", w != width - 1 ? 3 : 2);
+        }
+        out = appendIndented(out, rowIndent, h != height - 1 ? "],\n" : "]\n", h != height - 1 ? 3 : 2);
+    }
+    memset(out, ' ', rowIndent - 4);
+    out += rowIndent - 4;
+    *out++ = ']';
+
+    buffer.truncate(out - buffer.constData());
+}
+
+/**
+ * @brief RowCodec holds the lookup tables of the row string codecs. Encoding copies a
+ * ready-made pair of hex digits or base64 character per input; decoding maps every character
+ * through a table in which invalid characters are negative, and ORs the results so a row is
+ * checked once at the end instead of branching on every character.
+ */
+struct RowCodec
+{
+    char hexPairs[256][2];
+    signed char hexValues[256];
+    char base64Digits[64];
+    signed char base64Values[256];
+
+    RowCodec()
+    {
+        static const char hexDigits[] = "0123456789abcdef";
+        static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        memset(hexValues, -1, sizeof(hexValues));
+        memset(base64Values, -1, sizeof(base64Values));
+        for(int value = 0; value < 256; value++)
+        {
+            hexPairs[value][0] = hexDigits[value >> 4];
+            hexPairs[value][1] = hexDigits[value & 15];
+        }
+        for(int value = 0; value < 16; value++)
+        {
+            hexValues[(uchar)hexDigits[value]] = value;
+            // Upper case digits are accepted when reading, though never written
+            hexValues[(uchar)toupper(hexDigits[value])] = value;
+        }
+        for(int value = 0; value < 64; value++)
+        {
+            base64Digits[value] = digits[value];
+            base64Values[(uchar)digits[value]] = value;
+        }
+    }
+};
+
+static const RowCodec& rowCodec()
+{
+    static const RowCodec codec;
+    return codec;
+}
+
+/**
+ * @brief rgbaBytes unpacks a row of pixels into r, g, b, a bytes
+ */
+static void rgbaBytes(const QRgb* pixels, int width, uchar* out)
+{
+    for(int w = 0; w < width; w++)
+    {
+        out[0] = qRed(pixels[w]);
+        out[1] = qGreen(pixels[w]);
+        out[2] = qBlue(pixels[w]);
+        out[3] = qAlpha(pixels[w]);
+        out += 4;
+    }
+}
+
+int Frame::encodedRowLength(int width, RowEncoding encoding)
+{
+    return encoding == HexRows ? width * 8 : (width * 4 + 2) / 3 * 4;
+}
+
+char* Frame::encodeRow(const QRgb* pixels, int width, RowEncoding encoding, char* out)
+{
+    const RowCodec& codec = rowCodec();
+    if(encoding == HexRows)
+    {
+        for(int w = 0; w < width; w++)
         {
+            const QRgb pixel = pixels[w];
+            memcpy(out, codec.hexPairs[qRed(pixel)], 2);
+            memcpy(out + 2, codec.hexPairs[qGreen(pixel)], 2);
+            memcpy(out + 4, codec.hexPairs[qBlue(pixel)], 2);
+            memcpy(out + 6, codec.hexPairs[qAlpha(pixel)], 2);
+            out += 8;
+        }
+        return out;
+    }
+
+    // Base64 groups don't line up with pixels, so the row is unpacked into bytes first
+    thread_local std::vector<uchar> bytes;
+    const int byteCount = width * 4;
+    bytes.resize(byteCount + 2);
+    rgbaBytes(pixels, width, bytes.data());
+    bytes[byteCount] = 0;
+    bytes[byteCount + 1] = 0;
+    const uchar* in = bytes.data();
+    for(int i = 0; i < byteCount; i += 3)
+    {
+        const quint32 group = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        out[0] = codec.base64Digits[group >> 18];
+        out[1] = codec.base64Digits[(group >> 12) & 63];
+        out[2] = codec.base64Digits[(group >> 6) & 63];
+        out[3] = codec.base64Digits[group & 63];
+        out += 4;
+    }
+    // The final group is padded when the row isn't a multiple of three bytes
+    const int padding = (3 - byteCount % 3) % 3;
+    memset(out - padding, '=', padding);
+    return out;
+}
+
+int Frame::decodedRowWidth(const char* text, int length, RowEncoding encoding)
+{
+    if(encoding == HexRows)
+    {
+        return length % 8 == 0 ? length / 8 : -1;
+    }
+    if(length % 4 != 0)
+    {
+        return -1;
+    }
+    int byteCount = length / 4 * 3;
+    if(length > 0 && text[length - 1] == '=')
+    {
+        byteCount -= text[length - 2] == '=' ? 2 : 1;
+    }
+    return byteCount % 4 == 0 ? byteCount / 4 : -1;
+}
+
+bool Frame::decodeRow(const char* text, int length, RowEncoding encoding, QRgb* pixels, int width)
+{
+    if(decodedRowWidth(text, length, encoding) != width)
+    {
+        return false;
+    }
+    const RowCodec& codec = rowCodec();
+    const uchar* in = (const uchar*)text;
+    int invalid = 0;
+    if(encoding == HexRows)
+    {
+        for(int w = 0; w < width; w++)
+        {
+            int channels[4];
+            for(int c = 0; c < 4; c++)
+            {
+                const int high = codec.hexValues[in[c * 2]];
+                const int low = codec.hexValues[in[c * 2 + 1]];
+                invalid |= high | low;
+                channels[c] = (high << 4) | low;
+            }
+            pixels[w] = qRgba(channels[0] & 0xff, channels[1] & 0xff, channels[2] & 0xff, channels[3] & 0xff);
+            in += 8;
+        }
+        return invalid >= 0;
+    }
+
+    thread_local std::vector<uchar> bytes;
+    bytes.resize(length / 4 * 3);
+    uchar* out = bytes.data();
+    for(int i = 0; i < length; i += 4)
+    {
+        // Padding decodes as zero bits; it is only allowed where decodedRowWidth found it
+        const int a = codec.base64Values[in[i]];
+        const int b = codec.base64Values[in[i + 1]];
+        const int c = in[i + 2] == '=' && in[i + 3] == '=' && i + 4 == length ? 0 : codec.base64Values[in[i + 2]];
+        const int d = in[i + 3] == '=' && i + 4 == length ? 0 : codec.base64Values[in[i + 3]];
+        invalid |= a | b | c | d;
+        const quint32 group = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = group >> 16;
+        out[1] = group >> 8;
+        out[2] = group;
+        out += 3;
+    }
+    if(invalid < 0)
+    {
+        return false;
+    }
+    const uchar* rgba = bytes.data();
+    for(int w = 0; w < width; w++)
+    {
+        pixels[w] = qRgba(rgba[0], rgba[1], rgba[2], rgba[3]);
+        rgba += 4;
+    }
+    return true;
+}
+
+void Frame::writeRows(QByteArray& buffer, RowEncoding encoding) const
+{
+    materialize();
+    const int width = image.width();
+    const int height = image.height();
+    const qsizetype rowBound = rowIndent + encodedRowLength(width, encoding) + 4;
+    const qsizetype start = buffer.size();
+    buffer.resize(start + 4 + rowIndent + (qsizetype)height * rowBound);
+    char* out = buffer.data() + start;
+
+    *out++ = '[';
+    *out++ = '\n';
+    for(int h = 0; h < height; h++)
+    {
+        memset(out, ' ', rowIndent);
+        out += rowIndent;
+        *out++ = '"';
+        out = encodeRow((const QRgb*)image.constScanLine(h), width, encoding, out);
+        *out++ = '"';
+        if(h != height - 1)
+        {
+            *out++ = ',';
+        }
+        *out++ = '\n';
+    }
+    memset(out, ' ', rowIndent - 4);
+    out += rowIndent - 4;
+    *out++ = ']';
 
-            QJsonArray pixel;
+    buffer.truncate(out - buffer.constData());
+}
+
+int Frame::rawSize() const
+{
+    materialize();
+    return image.width() * image.height() * 4;
+}
+
+void Frame::writeRaw(uchar* dest) const
+{
+    materialize();
+    const int rowBytes = image.width() * 4;
+    for(int h = 0; h < image.height(); h++)
+    {
+        const uchar* row = image.constScanLine(h);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        memcpy(dest, row, rowBytes);
+#else
+        qToLittleEndian<quint32>(row, image.width(), dest);
+#endif
+        dest += rowBytes;
+    }
+}
 
-            QColor pColor = image.pixelColor(w,h);
+void Frame::readRaw(const uchar* src)
+{
+    materialize();
+    const int rowBytes = image.width() * 4;
+    for(int h = 0; h < image.height(); h++)
+    {
+        uchar* row = image.scanLine(h);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        memcpy(row, src, rowBytes);
+#else
+        qFromLittleEndian<quint32>(src, image.width(), row);
+#endif
+        src += rowBytes;
+    }
+}
 
-            pixel.append(pColor.red());
-            pixel.append(pColor.green());
-            pixel.append(pColor.blue());
-            pixel.append(pColor.alpha());
+void Frame::writeRgba(uchar* dest) const
+{
+    materialize();
+    for(int h = 0; h < image.height(); h++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(h);
+        for(int w = 0; w < image.width(); w++)
+        {
+            dest[0] = qRed(row[w]);
+            dest[1] = qGreen(row[w]);
+            dest[2] = qBlue(row[w]);
+            dest[3] = qAlpha(row[w]);
+            dest += 4;
+        }
+    }
+}
 
-            pixelsArray.append(pixel);
+void Frame::readRgba(const uchar* src)
+{
+    materialize();
+    for(int h = 0; h < image.height(); h++)
+    {
+        QRgb* row = (QRgb*)image.scanLine(h);
+        for(int w = 0; w < image.width(); w++)
+        {
+            row[w] = qRgba(src[0], src[1], src[2], src[3]);
+            src += 4;
         }
-        pixelRowsArray.append(pixelsArray);
     }
-    QString s = QString::number(frameNum);
-    json["frame" + s] = pixelRowsArray;
 }
@@ -3,15 +3,21 @@
 
 #include <QImage>
 #include <QPixmap>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
+#include <QByteArray>
+#include <functional>
+#include <vector>
 
 class Frame
 {
 private:
-    QImage image;
+    // Empty until loader has run for a frame that is decoded on first access
+    mutable QImage image;
+    mutable std::function<QImage()> loader;
 
+    /**
+     * @brief materialize runs the pending loader, if any, so image holds the frame's pixels
+     */
+    void materialize() const;
 
 public:
     /**
@@ -21,6 +27,37 @@ public:
      */
     Frame(int width, int height);
 
+    /**
+     * @brief Frame wraps an existing image, converting it to 32-bit ARGB if needed
+     * @param image the pixels of the frame
+     */
+    explicit Frame(const QImage& image);
+
+    /**
+     * @brief Frame defers producing its pixels until something first reads or paints them
+     * @param loader returns the frame's pixels; called at most once per copy of the frame
+     */
+    explicit Frame(std::function<QImage()> loader);
+
+    /**
+     * @brief isLoaded checks whether the frame's pixels have been produced yet
+     * @return false while a lazily opened frame hasn't been accessed
+     */
+    bool isLoaded() const;
+
+    /**
+     * @brief load produces the frame's pixels now instead of on first access, e.g. before the
+     * file they are decoded from is overwritten
+     */
+    void load() const;
+
+    /**
+     * @brief loadAll produces the pixels of every frame that hasn't been accessed yet,
+     * decoding them on the global thread pool
+     * @param frames the frames to load
+     */
+    static void loadAll(const std::vector<Frame>& frames);
+
     /**
      * @brief setPixel set a pixel with a specific color
      * @param x is the coordinate in the x axis of the frame
@@ -41,7 +78,7 @@ public:
      * @brief getImage returns the image
      * @return the image
      */
-    QImage getImage();
+    QImage getImage() const;
 
     /**
      * @brief getPixMap returns the pixMap
@@ -50,11 +87,30 @@ public:
     QPixmap getPixMap();
 
     /**
-     * @brief frameAsString generate a string format of the frame
+     * @brief frameAsString generate a string format of the frame: one line per row of
+     * "{ r, g, b, a, }" pixels. The exact length is computed first, so the string is
+     * allocated once and filled from a table of formatted byte values
      * @return a string of the frame
      */
     std::string frameAsString();
 
+    /**
+     * @brief exportText streams the frameAsString text to a file a row at a time, without
+     * building the whole string
+     * @param fileName the file to write
+     * @return a true/false on whether every byte could be written
+     */
+    bool exportText(QString fileName);
+
+    /**
+     * @brief exportHeader writes the frame as a C/C++ header for embedded targets: its width
+     * and height and an array of r, g, b, a bytes, row by row, all constexpr when compiled as
+     * C++ and const in C. The names are taken from the file name
+     * @param fileName the header to write, e.g. "player.h" declares player_pixels
+     * @return a true/false on whether every byte could be written
+     */
+    bool exportHeader(QString fileName);
+
     /**
      * @brief operator == compares a given image to this object image
      * @param rhs the other image
@@ -62,19 +118,138 @@ public:
      */
     bool operator==(const Frame& rhs);
 
+    /**
+     * @brief changedRect finds the bounding rectangle of every pixel that differs from
+     * another frame of the same size
+     * @param previous the frame to compare against
+     * @return the rectangle of changed pixels, an empty rectangle if the frames match
+     */
+    QRect changedRect(const Frame& previous) const;
+
+    /**
+     * @brief contentHash hashes the frame's pixels, so frames can be grouped before they are
+     * compared with samePixels
+     * @return the same value for any two frames with the same size and pixels
+     */
+    size_t contentHash() const;
+
+    /**
+     * @brief samePixels compares the frame's pixels with another frame's, byte for byte
+     * @param other the frame to compare against
+     * @return a true/false on whether both frames have the same size and pixels
+     */
+    bool samePixels(const Frame& other) const;
+
     /**
      * @brief exportPNG Export the string into a PNG format
      * @param fileName the filename that is being exported to a PNG
+     * @param compressionLevel the zlib level from 0, fastest, to 9, smallest; -1 for Qt's default
+     * @param scale how many times larger to write it, each pixel becoming a square block
      * @return a true/false on whether it was able to save it as a PNG
      */
-    bool exportPNG(QString fileName);
+    bool exportPNG(QString fileName, int compressionLevel = -1, int scale = 1);
+
+    /**
+     * @brief pngQuality converts a zlib level to the quality Qt's PNG writer takes
+     * @param compressionLevel the zlib level from 0, fastest, to 9, smallest; -1 for Qt's default
+     * @return the quality to pass to QImage::save
+     */
+    static int pngQuality(int compressionLevel);
+
+    /**
+     * @brief write appends the frame's rows to buffer as the indented JSON array stored
+     * under its "frameN" key in a .ssp file. Every channel is copied from a table of
+     * preformatted lines, so no number is formatted while saving
+     * @param buffer the text is appended here; callers can reuse one buffer for every frame
+     */
+    void write(QByteArray& buffer) const;
+
+    /**
+     * @brief The RowEncoding enum selects how each row is written as one string in version 2
+     * of the JSON schema. Both store the r, g, b, a bytes of every pixel: hex as two lowercase
+     * digits per byte, base64 as standard padded base64
+     */
+    enum RowEncoding{
+        HexRows,
+        Base64Rows
+    };
+
+    /**
+     * @brief writeRows appends the frame's rows to buffer as the indented JSON array of row
+     * strings stored under its "frameN" key in a version 2 .ssp file
+     * @param buffer the text is appended here; callers can reuse one buffer for every frame
+     * @param encoding how each row string is encoded
+     */
+    void writeRows(QByteArray& buffer, RowEncoding encoding) const;
+
+    /**
+     * @brief encodedRowLength returns the number of characters encodeRow produces
+     * @param width the number of pixels in the row
+     * @param encoding how the row is encoded
+     * @return the length of the row string, without quotes
+     */
+    static int encodedRowLength(int width, RowEncoding encoding);
+
+    /**
+     * @brief encodeRow writes one row of pixels as a row string
+     * @param pixels the row's ARGB32 pixels
+     * @param width the number of pixels in the row
+     * @param encoding how the row is encoded
+     * @param out a buffer of at least encodedRowLength(width, encoding) characters
+     * @return the position just past the last character written
+     */
+    static char* encodeRow(const QRgb* pixels, int width, RowEncoding encoding, char* out);
+
+    /**
+     * @brief decodedRowWidth finds how many pixels a row string holds
+     * @param text the row string, without quotes
+     * @param length the number of characters in text
+     * @param encoding how the row is encoded
+     * @return the number of pixels, or -1 if the length can't be a whole row
+     */
+    static int decodedRowWidth(const char* text, int length, RowEncoding encoding);
+
+    /**
+     * @brief decodeRow reads a row string back into pixels
+     * @param text the row string, without quotes
+     * @param length the number of characters in text
+     * @param encoding how the row is encoded
+     * @param pixels receives the row's ARGB32 pixels
+     * @param width the number of pixels the row must hold
+     * @return a true/false on whether the string was a valid row of exactly width pixels
+     */
+    static bool decodeRow(const char* text, int length, RowEncoding encoding, QRgb* pixels, int width);
+
+    /**
+     * @brief rawSize returns the number of bytes writeRaw produces for this frame
+     * @return width * height * 4
+     */
+    int rawSize() const;
+
+    /**
+     * @brief writeRaw copies the frame's scanlines into dest as little-endian ARGB32 pixels
+     * @param dest a buffer of at least rawSize() bytes
+     */
+    void writeRaw(uchar* dest) const;
+
+    /**
+     * @brief readRaw fills the frame from little-endian ARGB32 pixels produced by writeRaw
+     * @param src a buffer of at least rawSize() bytes
+     */
+    void readRaw(const uchar* src);
+
+    /**
+     * @brief writeRgba copies the frame's pixels into dest as r, g, b, a bytes, row by row;
+     * the channel order of the JSON schema
+     * @param dest a buffer of at least rawSize() bytes
+     */
+    void writeRgba(uchar* dest) const;
 
     /**
-     * @brief write stores a given frame to the json array
-     * @param json is the object that is used to store the frame in an array
-     * @param framNum the frame number
+     * @brief readRgba fills the frame from r, g, b, a bytes produced by writeRgba
+     * @param src a buffer of at least rawSize() bytes
      */
-    void write(QJsonObject &json, int framNum) const;
+    void readRgba(const uchar* src);
 
     /**
      * @brief read
@@ -0,0 +1,659 @@
+#include "gifencoder.h"
+#include "parallelencode.h"
+#include <QHash>
+#include <QRect>
+#include <QSet>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+
+// Pixels less opaque than this are shown as transparent
+static const int alphaThreshold = 128;
+// The most colors a color table holds; the last of the 256 indices is kept for transparency
+static const int maxColors = 255;
+// GIF codes are at most 12 bits; the dictionary starts over when the last one is taken
+static const int maxLzwCode = 4095;
+// Delays are stored in hundredths of a second in 16 bits
+static const int maxDelay = 65535;
+
+/**
+ * @brief showable returns a pixel as GIF can show it: 0 if transparent, opaque otherwise
+ */
+static inline QRgb showable(QRgb pixel)
+{
+    return qAlpha(pixel) < alphaThreshold ? 0 : (pixel | 0xff000000);
+}
+
+/**
+ * @brief showablePixels returns the image with every pixel as GIF can show it. Images that
+ * already are, as pixel art nearly always is, are returned without copying
+ */
+static QImage showablePixels(const QImage& image)
+{
+    const int width = image.width();
+    const int height = image.height();
+    for(int y = 0; y < height; y++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(y);
+        for(int x = 0; x < width; x++)
+        {
+            if(row[x] != showable(row[x]))
+            {
+                QImage converted = image.copy();
+                for(int cy = 0; cy < height; cy++)
+                {
+                    QRgb* pixels = (QRgb*)converted.scanLine(cy);
+                    for(int cx = 0; cx < width; cx++)
+                    {
+                        pixels[cx] = showable(pixels[cx]);
+                    }
+                }
+                return converted;
+            }
+        }
+    }
+    return image;
+}
+
+/**
+ * @brief The PlannedFrame struct is what is stored of one frame of the Sprite
+ */
+struct PlannedFrame
+{
+    // The frame the pixels come from, and the one on screen before it, or -1 for the first
+    int frame = 0;
+    int previous = -1;
+    // The rectangle of the previous frame that was cleared after it was shown, if any
+    QRect clearedBefore;
+    // The rectangle stored, which covers every pixel that differs from the screen before it
+    QRect rect;
+    // Clear rect to transparent after the frame is shown, so the next frame can show
+    // transparent pixels where this one has opaque ones
+    bool clearAfter = false;
+    int delay = 0;
+};
+
+/**
+ * @brief screenBefore returns a pixel of the screen just before a planned frame is shown
+ */
+static inline QRgb screenBefore(const std::vector<QImage>& pixels, const PlannedFrame& planned, int x, int y)
+{
+    if(planned.previous < 0 || planned.clearedBefore.contains(x, y))
+    {
+        return 0;
+    }
+    return ((const QRgb*)pixels[planned.previous].constScanLine(y))[x];
+}
+
+/**
+ * @brief changedRect finds the bounding rectangle of the pixels of a planned frame that differ
+ * from the screen before it
+ */
+static QRect changedRect(const std::vector<QImage>& pixels, const PlannedFrame& planned)
+{
+    const QImage& image = pixels[planned.frame];
+    int left = image.width(), right = -1, top = -1, bottom = -1;
+    for(int y = 0; y < image.height(); y++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(y);
+        for(int x = 0; x < image.width(); x++)
+        {
+            if(row[x] != screenBefore(pixels, planned, x, y))
+            {
+                left = std::min(left, x);
+                right = std::max(right, x);
+                top = top < 0 ? y : top;
+                bottom = y;
+            }
+        }
+    }
+    return top < 0 ? QRect() : QRect(left, top, right - left + 1, bottom - top + 1);
+}
+
+/**
+ * @brief clearedRect finds the bounding rectangle of the pixels that are opaque in one frame
+ * and transparent in the next
+ */
+static QRect clearedRect(const QImage& previous, const QImage& next)
+{
+    int left = next.width(), right = -1, top = -1, bottom = -1;
+    for(int y = 0; y < next.height(); y++)
+    {
+        const QRgb* before = (const QRgb*)previous.constScanLine(y);
+        const QRgb* after = (const QRgb*)next.constScanLine(y);
+        for(int x = 0; x < next.width(); x++)
+        {
+            if(before[x] != 0 && after[x] == 0)
+            {
+                left = std::min(left, x);
+                right = std::max(right, x);
+                top = top < 0 ? y : top;
+                bottom = y;
+            }
+        }
+    }
+    return top < 0 ? QRect() : QRect(left, top, right - left + 1, bottom - top + 1);
+}
+
+/**
+ * @brief planFrames decides which rectangle of which frames is stored and which frames are
+ * cleared after they are shown. A frame identical to the one before it isn't stored at all;
+ * the one before is shown for longer instead
+ */
+static std::vector<PlannedFrame> planFrames(const std::vector<QImage>& pixels, int delay)
+{
+    const int count = (int)pixels.size();
+    std::vector<QRect> cleared(count);
+    std::vector<int> indices;
+    for(int i = 1; i < count; i++)
+    {
+        indices.push_back(i);
+    }
+    QtConcurrent::blockingMap(indices, [&](int i){
+        cleared[i] = clearedRect(pixels[i - 1], pixels[i]);
+    });
+
+    std::vector<PlannedFrame> planned;
+    for(int i = 0; i < count; i++)
+    {
+        PlannedFrame frame;
+        frame.frame = i;
+        frame.delay = delay;
+        if(!planned.empty())
+        {
+            PlannedFrame& last = planned.back();
+            if(!cleared[i].isEmpty())
+            {
+                last.clearAfter = true;
+                last.rect |= cleared[i];
+            }
+            frame.previous = i - 1;
+            frame.clearedBefore = last.clearAfter ? last.rect : QRect();
+        }
+
+        frame.rect = changedRect(pixels, frame);
+        if(frame.rect.isEmpty())
+        {
+            if(!planned.empty() && !planned.back().clearAfter && planned.back().delay + delay <= maxDelay)
+            {
+                planned.back().delay += delay;
+                continue;
+            }
+            // Nothing changed, but the frame still has to be shown for its delay
+            frame.rect = QRect(0, 0, 1, 1);
+        }
+        planned.push_back(frame);
+    }
+    return planned;
+}
+
+/**
+ * @brief globalPalette collects every opaque color of the animation, sorted
+ * @return a true/false on whether there are few enough colors to share one color table
+ */
+static bool globalPalette(const std::vector<QImage>& pixels, std::vector<QRgb>& palette)
+{
+    std::vector<QSet<QRgb>> colors(pixels.size());
+    std::vector<int> indices(pixels.size());
+    for(int i = 0; i < (int)pixels.size(); i++)
+    {
+        indices[i] = i;
+    }
+    QtConcurrent::blockingMap(indices, [&](int i){
+        const QImage& image = pixels[i];
+        for(int y = 0; y < image.height() && colors[i].size() <= maxColors; y++)
+        {
+            const QRgb* row = (const QRgb*)image.constScanLine(y);
+            for(int x = 0; x < image.width(); x++)
+            {
+                if(row[x] != 0)
+                {
+                    colors[i].insert(row[x]);
+                }
+            }
+        }
+    });
+
+    QSet<QRgb> all;
+    for(const QSet<QRgb>& frameColors : colors)
+    {
+        all.unite(frameColors);
+        if(all.size() > maxColors)
+        {
+            return false;
+        }
+    }
+    palette.assign(all.begin(), all.end());
+    std::sort(palette.begin(), palette.end());
+    return true;
+}
+
+/**
+ * @brief The ColorCount struct is one distinct color of a frame and how many pixels have it
+ */
+struct ColorCount
+{
+    QRgb color;
+    int count;
+};
+
+/**
+ * @brief medianCut picks at most maxColors colors for a frame. The colors are split into boxes,
+ * each time halving the box with the widest range of one channel at the median pixel along that
+ * channel, and every box becomes the average of its pixels
+ * @param colors the distinct colors of the frame; reordered
+ * @param palette filled with the chosen colors
+ * @param indexOf filled with the palette index of every distinct color
+ */
+static void medianCut(std::vector<ColorCount>& colors, std::vector<QRgb>& palette, QHash<QRgb, int>& indexOf)
+{
+    auto channel = [](QRgb color, int c){ return (int)(color >> (16 - 8 * c)) & 0xff; };
+    struct Box
+    {
+        int begin;
+        int end;
+        int widestChannel;
+        int range;
+    };
+    auto measure = [&](int begin, int end){
+        Box box = {begin, end, 0, -1};
+        for(int c = 0; c < 3; c++)
+        {
+            int low = 255, high = 0;
+            for(int i = begin; i < end; i++)
+            {
+                low = std::min(low, channel(colors[i].color, c));
+                high = std::max(high, channel(colors[i].color, c));
+            }
+            if(high - low > box.range)
+            {
+                box.range = high - low;
+                box.widestChannel = c;
+            }
+        }
+        return box;
+    };
+
+    std::vector<Box> boxes = {measure(0, (int)colors.size())};
+    while((int)boxes.size() < maxColors)
+    {
+        int widest = -1;
+        for(int b = 0; b < (int)boxes.size(); b++)
+        {
+            if(boxes[b].end - boxes[b].begin > 1 && (widest < 0 || boxes[b].range > boxes[widest].range))
+            {
+                widest = b;
+            }
+        }
+        if(widest < 0)
+        {
+            break;
+        }
+        Box box = boxes[widest];
+        std::sort(colors.begin() + box.begin, colors.begin() + box.end, [&](const ColorCount& a, const ColorCount& b){
+            return channel(a.color, box.widestChannel) < channel(b.color, box.widestChannel);
+        });
+        qint64 total = 0;
+        for(int i = box.begin; i < box.end; i++)
+        {
+            total += colors[i].count;
+        }
+        // Split where half the box's pixels fall on each side, leaving at least one color in each
+        int split = box.begin + 1;
+        for(qint64 below = colors[box.begin].count; split < box.end - 1 && below * 2 < total; split++)
+        {
+            below += colors[split].count;
+        }
+        boxes[widest] = measure(box.begin, split);
+        boxes.push_back(measure(split, box.end));
+    }
+
+    palette.clear();
+    for(const Box& box : boxes)
+    {
+        qint64 sums[3] = {0, 0, 0}, total = 0;
+        for(int i = box.begin; i < box.end; i++)
+        {
+            for(int c = 0; c < 3; c++)
+            {
+                sums[c] += (qint64)channel(colors[i].color, c) * colors[i].count;
+            }
+            total += colors[i].count;
+            indexOf.insert(colors[i].color, (int)palette.size());
+        }
+        palette.push_back(qRgb((int)((sums[0] + total / 2) / total), (int)((sums[1] + total / 2) / total),
+                               (int)((sums[2] + total / 2) / total)));
+    }
+}
+
+/**
+ * @brief LzwDictionary maps a code plus the next index to the code of the longer string. It is
+ * an open addressed hash table big enough for every 12-bit code, and each entry is stamped
+ * with a generation so starting over costs nothing; every thread keeps one and reuses it for
+ * every frame it encodes
+ */
+struct LzwDictionary
+{
+    static const int size = 8192;
+    quint32 stamps[size];
+    quint32 keys[size];
+    quint16 codes[size];
+    quint32 generation = 0;
+
+    LzwDictionary()
+    {
+        memset(stamps, 0, sizeof(stamps));
+    }
+
+    void reset()
+    {
+        if(++generation == 0)
+        {
+            memset(stamps, 0, sizeof(stamps));
+            generation = 1;
+        }
+    }
+
+    /**
+     * @brief slot returns where key is, or the empty slot it would go in
+     */
+    int slot(quint32 key) const
+    {
+        int slot = (int)((key * 2654435761u) >> 19);
+        while(stamps[slot] == generation && keys[slot] != key)
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+        return slot;
+    }
+
+    bool contains(int slot) const
+    {
+        return stamps[slot] == generation;
+    }
+
+    void insert(int slot, quint32 key, int code)
+    {
+        stamps[slot] = generation;
+        keys[slot] = key;
+        codes[slot] = (quint16)code;
+    }
+};
+
+/**
+ * @brief The BitWriter struct packs variable length codes into bytes, least significant bit
+ * first, as GIF stores them
+ */
+struct BitWriter
+{
+    QByteArray& out;
+    quint32 buffer = 0;
+    int bits = 0;
+
+    explicit BitWriter(QByteArray& _out) : out(_out) {}
+
+    void write(int code, int size)
+    {
+        buffer |= (quint32)code << bits;
+        bits += size;
+        while(bits >= 8)
+        {
+            out.append((char)(buffer & 0xff));
+            buffer >>= 8;
+            bits -= 8;
+        }
+    }
+
+    void flush()
+    {
+        if(bits > 0)
+        {
+            out.append((char)(buffer & 0xff));
+        }
+    }
+};
+
+/**
+ * @brief lzwEncode compresses palette indices with GIF's variable length LZW
+ * @param out the codes are appended here, not yet split into sub-blocks
+ */
+static void lzwEncode(const std::vector<uchar>& indices, int minCodeSize, QByteArray& out)
+{
+    static thread_local LzwDictionary dictionary;
+    dictionary.reset();
+
+    const int clearCode = 1 << minCodeSize;
+    int codeSize = minCodeSize + 1;
+    int maxCode = clearCode + 1;
+    BitWriter bits(out);
+    bits.write(clearCode, codeSize);
+
+    int current = indices[0];
+    for(size_t i = 1; i < indices.size(); i++)
+    {
+        const quint32 key = (quint32)current << 8 | indices[i];
+        const int slot = dictionary.slot(key);
+        if(dictionary.contains(slot))
+        {
+            current = dictionary.codes[slot];
+            continue;
+        }
+        bits.write(current, codeSize);
+        dictionary.insert(slot, key, ++maxCode);
+        if(maxCode >= (1 << codeSize))
+        {
+            codeSize++;
+        }
+        if(maxCode == maxLzwCode)
+        {
+            bits.write(clearCode, codeSize);
+            dictionary.reset();
+            codeSize = minCodeSize + 1;
+            maxCode = clearCode + 1;
+        }
+        current = indices[i];
+    }
+    bits.write(current, codeSize);
+    // Reading the last code adds one more entry to the decoder's dictionary, which may widen
+    // the code the end marker is read with
+    if(maxCode + 1 >= (1 << codeSize) && codeSize < 12 && maxCode > clearCode + 1)
+    {
+        codeSize++;
+    }
+    bits.write(clearCode + 1, codeSize);
+    bits.flush();
+}
+
+static void appendLe16(QByteArray& out, int value)
+{
+    out.append((char)(value & 0xff));
+    out.append((char)((value >> 8) & 0xff));
+}
+
+/**
+ * @brief tableBits returns the number of bits a color table needs for the colors plus the
+ * transparent index; GIF tables have 2 to 256 entries
+ */
+static int tableBits(int colorCount)
+{
+    int bits = 1;
+    while((1 << bits) < colorCount + 1)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+static void appendColorTable(QByteArray& out, const std::vector<QRgb>& palette, int bits)
+{
+    for(int i = 0; i < (1 << bits); i++)
+    {
+        QRgb color = i < (int)palette.size() ? palette[i] : 0;
+        out.append((char)qRed(color));
+        out.append((char)qGreen(color));
+        out.append((char)qBlue(color));
+    }
+}
+
+/**
+ * @brief encodeFrame appends a planned frame as a graphic control extension, an image
+ * descriptor, its own color table unless the global one is used, and its LZW data
+ * @param global the global color table, or nullptr if each frame has its own
+ * @param globalIndex the index of every color in the global table
+ */
+static void encodeFrame(const std::vector<QImage>& pixels, const PlannedFrame& planned,
+                        const std::vector<QRgb>* global, const QHash<QRgb, int>& globalIndex, QByteArray& out)
+{
+    const QRect& rect = planned.rect;
+    const QImage& image = pixels[planned.frame];
+
+    // Pixels that match the screen are left transparent, which keeps what is already there
+    std::vector<QRgb> shown((size_t)rect.width() * rect.height());
+    for(int y = 0; y < rect.height(); y++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(rect.y() + y);
+        for(int x = 0; x < rect.width(); x++)
+        {
+            const QRgb pixel = row[rect.x() + x];
+            const bool unchanged = pixel == screenBefore(pixels, planned, rect.x() + x, rect.y() + y);
+            shown[(size_t)y * rect.width() + x] = unchanged ? 0 : pixel;
+        }
+    }
+
+    std::vector<QRgb> localPalette;
+    QHash<QRgb, int> localIndex;
+    if(!global)
+    {
+        QHash<QRgb, int> counts;
+        for(QRgb pixel : shown)
+        {
+            if(pixel != 0)
+            {
+                counts[pixel]++;
+            }
+        }
+        std::vector<ColorCount> colors;
+        colors.reserve(counts.size());
+        for(auto it = counts.constBegin(); it != counts.constEnd(); ++it)
+        {
+            colors.push_back({it.key(), it.value()});
+        }
+        std::sort(colors.begin(), colors.end(), [](const ColorCount& a, const ColorCount& b){
+            return a.color < b.color;
+        });
+        if((int)colors.size() <= maxColors)
+        {
+            for(const ColorCount& color : colors)
+            {
+                localIndex.insert(color.color, (int)localPalette.size());
+                localPalette.push_back(color.color);
+            }
+        }
+        else
+        {
+            medianCut(colors, localPalette, localIndex);
+        }
+    }
+    const std::vector<QRgb>& palette = global ? *global : localPalette;
+    const QHash<QRgb, int>& indexOf = global ? globalIndex : localIndex;
+    const int transparentIndex = (int)palette.size();
+    const int bits = tableBits((int)palette.size());
+
+    std::vector<uchar> indices(shown.size());
+    for(size_t i = 0; i < shown.size(); i++)
+    {
+        indices[i] = (uchar)(shown[i] == 0 ? transparentIndex : indexOf.value(shown[i]));
+    }
+
+    // Graphic control extension: disposal, transparency and delay
+    out.append("\x21\xf9\x04", 3);
+    out.append((char)(((planned.clearAfter ? 2 : 1) << 2) | 1));
+    appendLe16(out, planned.delay);
+    out.append((char)transparentIndex);
+    out.append('\0');
+
+    out.append('\x2c');
+    appendLe16(out, rect.x());
+    appendLe16(out, rect.y());
+    appendLe16(out, rect.width());
+    appendLe16(out, rect.height());
+    if(global)
+    {
+        out.append('\0');
+    }
+    else
+    {
+        out.append((char)(0x80 | (bits - 1)));
+        appendColorTable(out, localPalette, bits);
+    }
+
+    const int minCodeSize = std::max(2, bits);
+    QByteArray codes;
+    lzwEncode(indices, minCodeSize, codes);
+    out.append((char)minCodeSize);
+    for(qsizetype offset = 0; offset < codes.size(); offset += 255)
+    {
+        const int length = (int)std::min<qsizetype>(255, codes.size() - offset);
+        out.append((char)length);
+        out.append(codes.constData() + offset, length);
+    }
+    out.append('\0');
+}
+
+bool GifEncoder::write(QIODevice& device, const std::vector<Frame>& frames, int frameDuration)
+{
+    if(frames.empty())
+    {
+        return false;
+    }
+    Frame::loadAll(frames);
+
+    const int count = (int)frames.size();
+    std::vector<QImage> pixels(count);
+    std::vector<int> indices(count);
+    for(int i = 0; i < count; i++)
+    {
+        indices[i] = i;
+    }
+    QtConcurrent::blockingMap(indices, [&](int i){
+        pixels[i] = showablePixels(frames[i].getImage());
+    });
+    const int width = pixels[0].width();
+    const int height = pixels[0].height();
+
+    const int delay = std::max(2, std::min(maxDelay, (frameDuration + 5) / 10));
+    const std::vector<PlannedFrame> planned = planFrames(pixels, delay);
+
+    std::vector<QRgb> palette;
+    const bool useGlobal = globalPalette(pixels, palette);
+    QHash<QRgb, int> globalIndex;
+    for(int i = 0; i < (int)palette.size(); i++)
+    {
+        globalIndex.insert(palette[i], i);
+    }
+    const int globalBits = tableBits((int)palette.size());
+
+    QByteArray header("GIF89a");
+    appendLe16(header, width);
+    appendLe16(header, height);
+    header.append((char)(useGlobal ? 0xf0 | (globalBits - 1) : 0x70));
+    header.append((char)(useGlobal ? palette.size() : 0));
+    header.append('\0');
+    if(useGlobal)
+    {
+        appendColorTable(header, palette, globalBits);
+    }
+    // Loop forever
+    header.append("\x21\xff\x0bNETSCAPE2.0\x03\x01\x00\x00\x00", 19);
+    if(device.write(header) != header.size())
+    {
+        return false;
+    }
+
+    bool written = encodeFramesInOrder(device, (int)planned.size(),
+        [&](int i, QByteArray& buffer){
+            encodeFrame(pixels, planned[i], useGlobal ? &palette : nullptr, globalIndex, buffer);
+        },
+        [](int, const QByteArray&){});
+    return written && device.write("\x3b", 1) == 1;
+}
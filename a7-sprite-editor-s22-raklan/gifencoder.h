@@ -0,0 +1,40 @@
+#ifndef GIFENCODER_H
+#define GIFENCODER_H
+
+#include <QIODevice>
+#include <vector>
+#include "frame.h"
+
+/**
+ * @brief GifEncoder writes the frames of a Sprite as a looping GIF89a animation.
+ *
+ * GIF pixels are either opaque or fully transparent, so pixels less than half opaque become
+ * transparent and the rest lose their alpha. When the whole animation uses 255 colors or
+ * fewer they form one global color table and every frame is exact. Otherwise each frame gets
+ * its own table of at most 255 colors, chosen by median cut. Either way one more index is
+ * kept for transparency.
+ *
+ * Each frame only stores the rectangle that changed since the previous one. Inside it,
+ * pixels that didn't change are written as the transparent index, so they keep what is
+ * already on screen and compress to long runs. A frame is cleared after it is shown
+ * (disposal 2) only when the next frame needs pixels to turn transparent; its rectangle is
+ * grown to cover them first.
+ *
+ * The changed rectangles are planned in order, then the frames are quantized and LZW encoded
+ * in parallel and written out in order.
+ */
+class GifEncoder
+{
+public:
+    /**
+     * @brief write encodes the frames as a GIF that loops forever
+     * @param device an open, writable device
+     * @param frames the frames of the Sprite, in order; all the same size
+     * @param frameDuration how long each frame is shown in milliseconds; GIF stores it in
+     * hundredths of a second, and at least two, as most viewers slow shorter delays down
+     * @return a true/false on whether every byte could be written
+     */
+    static bool write(QIODevice& device, const std::vector<Frame>& frames, int frameDuration);
+};
+
+#endif // GIFENCODER_H
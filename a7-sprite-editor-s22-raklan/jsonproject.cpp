@@ -0,0 +1,1035 @@
+#include "jsonproject.h"
+#include "parallelencode.h"
+#include "Library/json.hpp"
+#include <QDebug>
+#include <QFileDevice>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+
+using json = nlohmann::json;
+
+// Size of each read from the device while parsing
+static const qint64 readChunkSize = 64 * 1024;
+
+// Highest "frameN" key accepted, guards against resizing to garbage indices
+static const int maxFrameIndex = 100000;
+
+// Newest version of the JSON schema this reader understands
+static const int schemaVersion = 2;
+
+// CBOR's self-describe tag, written at the start of CBOR projects so they can be told apart
+static const char cborTag[3] = {'\xd9', '\xd9', '\xf7'};
+
+/**
+ * @brief DeviceBuffer refills a fixed window of bytes from a QIODevice so the parser
+ * never needs the whole file in memory
+ */
+struct DeviceBuffer
+{
+    QIODevice* device;
+    QByteArray window;
+    const char* cursor = nullptr;
+    const char* end = nullptr;
+    qint64 consumed = 0;
+    // Called with the bytes read so far after every refill; returning false ends the input
+    std::function<bool(qint64)> refilled;
+
+    explicit DeviceBuffer(QIODevice* _device, std::function<bool(qint64)> _refilled = nullptr)
+        : device(_device), refilled(std::move(_refilled))
+    {
+        refill();
+    }
+
+    void refill()
+    {
+        window.resize(readChunkSize);
+        qint64 bytesRead = device->read(window.data(), readChunkSize);
+        consumed += std::max<qint64>(bytesRead, 0);
+        cursor = window.constData();
+        end = cursor + std::max<qint64>(bytesRead, 0);
+        if(refilled && !refilled(consumed))
+        {
+            end = cursor;
+        }
+    }
+};
+
+/**
+ * @brief DeviceIterator is the single pass input iterator json.hpp reads characters through
+ */
+class DeviceIterator
+{
+    DeviceBuffer* source;
+
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char*;
+    using reference = const char&;
+
+    explicit DeviceIterator(DeviceBuffer* _source = nullptr) : source(_source) {}
+
+    reference operator*() const
+    {
+        return *source->cursor;
+    }
+
+    DeviceIterator& operator++()
+    {
+        if(++source->cursor == source->end)
+        {
+            source->refill();
+        }
+        return *this;
+    }
+
+    DeviceIterator operator++(int)
+    {
+        DeviceIterator previous = *this;
+        ++(*this);
+        return previous;
+    }
+
+    bool atEnd() const
+    {
+        return source == nullptr || source->cursor == source->end;
+    }
+
+    bool operator==(const DeviceIterator& rhs) const
+    {
+        return atEnd() == rhs.atEnd();
+    }
+
+    bool operator!=(const DeviceIterator& rhs) const
+    {
+        return !(*this == rhs);
+    }
+};
+
+/**
+ * @brief ProjectSaxHandler receives the parser's events and writes pixels straight into
+ * each frame's scanlines. The writer sorts keys, so "frames" arrives before "width" and
+ * "height"; the dimensions are taken from the first frame instead, which is the only
+ * frame that has to be buffered before its image can be allocated. Version 2 files write
+ * the dimensions first, so nothing is buffered for them. The same handler also decodes a
+ * lone frame array when the loader has already split the file into frames.
+ */
+class ProjectSaxHandler : public nlohmann::json_sax<json>
+{
+    // In a whole document the frames object sits at depth 2, so a frame is 3, a row 4 and
+    // a pixel 5. A lone frame array starts at depth 1.
+    int depth = 0;
+    int frameDepth = 3;
+    bool inFrames = false;
+    bool buffering = false;
+    int frameIndex = -1;
+    int x = 0;
+    int y = 0;
+    int channel = 0;
+    int channels[4];
+    QRgb* row = nullptr;
+    QImage image;
+    std::vector<QRgb> firstFrame;
+    std::string rootKey;
+
+    void storeNumber(qint64 value)
+    {
+        if(depth == frameDepth + 2 && inFrames)
+        {
+            if(channel < 4)
+            {
+                channels[channel++] = (int)qBound<qint64>(0, value, 255);
+            }
+        }
+        else if(depth == 1 && !inFrames)
+        {
+            if(rootKey == "height")
+            {
+                height = (int)value;
+            }
+            else if(rootKey == "width")
+            {
+                width = (int)value;
+            }
+            else if(rootKey == "version")
+            {
+                version = (int)value;
+            }
+        }
+    }
+
+    /**
+     * @brief storeRow decodes a version 2 row string into the next row of the frame
+     * @return false if the string isn't a valid row
+     */
+    bool storeRow(const string_t& text)
+    {
+        beginRow();
+        bool valid;
+        if(buffering)
+        {
+            const int count = Frame::decodedRowWidth(text.data(), (int)text.size(), rowEncoding);
+            valid = count >= 0;
+            if(valid)
+            {
+                const size_t start = firstFrame.size();
+                firstFrame.resize(start + count);
+                valid = Frame::decodeRow(text.data(), (int)text.size(), rowEncoding, firstFrame.data() + start, count);
+                x = count;
+            }
+        }
+        else
+        {
+            // Rows past the frame's height are dropped, as extra pixel arrays are
+            valid = row == nullptr || Frame::decodeRow(text.data(), (int)text.size(), rowEncoding, row, frameWidth);
+        }
+        if(!valid)
+        {
+            qWarning("Save file has a malformed row.");
+            return false;
+        }
+        endRow();
+        return true;
+    }
+
+    void beginFrame()
+    {
+        y = 0;
+        if(frameWidth == 0 && width > 0 && height > 0)
+        {
+            frameWidth = width;
+            frameHeight = height;
+        }
+        buffering = frameWidth == 0;
+        if(!buffering)
+        {
+            image = QImage(frameWidth, frameHeight, QImage::Format_ARGB32);
+            image.fill(0);
+        }
+    }
+
+    void beginRow()
+    {
+        x = 0;
+        row = buffering || y >= frameHeight ? nullptr : (QRgb*)image.scanLine(y);
+    }
+
+    void endPixel()
+    {
+        while(channel < 4)
+        {
+            channels[channel++] = 0;
+        }
+        QRgb pixel = qRgba(channels[0], channels[1], channels[2], channels[3]);
+        if(buffering)
+        {
+            firstFrame.push_back(pixel);
+        }
+        else if(row != nullptr && x < frameWidth)
+        {
+            row[x] = pixel;
+        }
+        x++;
+    }
+
+    void endRow()
+    {
+        if(buffering && y == 0)
+        {
+            firstRowWidth = x;
+        }
+        y++;
+    }
+
+    void endFrame()
+    {
+        if(buffering)
+        {
+            // First frame: its height is only known now that every row has been read
+            if(firstRowWidth == 0 || y == 0)
+            {
+                firstFrame.clear();
+                return;
+            }
+            frameWidth = firstRowWidth;
+            frameHeight = y;
+            image = QImage(frameWidth, frameHeight, QImage::Format_ARGB32);
+            image.fill(0);
+            for(int h = 0; h < frameHeight; h++)
+            {
+                QRgb* dest = (QRgb*)image.scanLine(h);
+                for(int w = 0; w < frameWidth && h * frameWidth + w < (int)firstFrame.size(); w++)
+                {
+                    dest[w] = firstFrame[h * frameWidth + w];
+                }
+            }
+            firstFrame.clear();
+            firstFrame.shrink_to_fit();
+        }
+        if(frameIndex >= 0)
+        {
+            if(frameIndex >= (int)images.size())
+            {
+                images.resize(frameIndex + 1);
+            }
+            images[frameIndex] = image;
+            framesDecoded++;
+            if(progress != nullptr)
+            {
+                if(frameIndex == 0)
+                {
+                    progress->reportFirstFrame(image);
+                }
+                reportProgress();
+            }
+        }
+        image = QImage();
+    }
+
+public:
+    /**
+     * @brief PackedFrame is a frame's r, g, b, a bytes as stored in a CBOR or MessagePack project
+     */
+    struct PackedFrame
+    {
+        int index;
+        std::vector<std::uint8_t> bytes;
+    };
+
+    std::vector<QImage> images;
+    std::vector<PackedFrame> packedFrames;
+    Frame::RowEncoding rowEncoding = Frame::HexRows;
+    int version = 1;
+    // Where a read of a whole document reports to; lone frames leave it unset
+    const ReadProgress* progress = nullptr;
+    qint64 bytesRead = 0;
+    int framesDecoded = 0;
+    bool cancelled = false;
+
+    /**
+     * @brief reportProgress passes the bytes read and frames decoded so far to progress
+     * @return false once the read has been cancelled
+     */
+    bool reportProgress()
+    {
+        if(!cancelled && progress != nullptr && !progress->report(bytesRead, framesDecoded))
+        {
+            cancelled = true;
+        }
+        return !cancelled;
+    }
+    int firstRowWidth = 0;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    int width = 0;
+    int height = 0;
+
+    ProjectSaxHandler() {}
+
+    /**
+     * @brief Prepares the handler to decode one frame's array of the given size into images[0]
+     */
+    ProjectSaxHandler(int _frameWidth, int _frameHeight, Frame::RowEncoding _rowEncoding)
+        : frameDepth(1), inFrames(true), frameIndex(0), rowEncoding(_rowEncoding),
+          frameWidth(_frameWidth), frameHeight(_frameHeight)
+    {
+    }
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+
+    bool string(string_t& val) override
+    {
+        if(inFrames && depth == frameDepth)
+        {
+            return storeRow(val);
+        }
+        if(depth == 1 && !inFrames && rootKey == "rowEncoding")
+        {
+            if(val != "hex" && val != "base64")
+            {
+                qWarning("Save file has an unsupported row encoding.");
+                return false;
+            }
+            rowEncoding = val == "hex" ? Frame::HexRows : Frame::Base64Rows;
+        }
+        return true;
+    }
+
+    bool binary(binary_t& val) override
+    {
+        // CBOR and MessagePack frames are one byte string each, expanded once the
+        // dimensions are known
+        if(inFrames && depth == frameDepth - 1 && frameIndex >= 0)
+        {
+            packedFrames.push_back(PackedFrame{frameIndex, std::move(val)});
+        }
+        return true;
+    }
+
+    bool number_integer(number_integer_t val) override
+    {
+        storeNumber(val);
+        return true;
+    }
+
+    bool number_unsigned(number_unsigned_t val) override
+    {
+        storeNumber((qint64)std::min<number_unsigned_t>(val, 0x7fffffff));
+        return true;
+    }
+
+    bool number_float(number_float_t val, const string_t&) override
+    {
+        storeNumber((qint64)val);
+        return true;
+    }
+
+    bool start_object(std::size_t) override
+    {
+        depth++;
+        if(depth == 2 && rootKey == "frames")
+        {
+            inFrames = true;
+        }
+        return true;
+    }
+
+    bool key(string_t& val) override
+    {
+        if(depth == 1)
+        {
+            rootKey = val;
+        }
+        else if(depth == 2 && inFrames)
+        {
+            frameIndex = val.compare(0, 5, "frame") == 0 ? atoi(val.c_str() + 5) : -1;
+            if(frameIndex > maxFrameIndex)
+            {
+                frameIndex = -1;
+            }
+        }
+        return true;
+    }
+
+    bool end_object() override
+    {
+        if(depth == 2)
+        {
+            inFrames = false;
+        }
+        depth--;
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        depth++;
+        if(inFrames)
+        {
+            if(depth == frameDepth)
+            {
+                beginFrame();
+            }
+            else if(depth == frameDepth + 1)
+            {
+                beginRow();
+            }
+            else if(depth == frameDepth + 2)
+            {
+                channel = 0;
+            }
+        }
+        return true;
+    }
+
+    bool end_array() override
+    {
+        if(inFrames)
+        {
+            if(depth == frameDepth + 2)
+            {
+                endPixel();
+            }
+            else if(depth == frameDepth + 1)
+            {
+                endRow();
+            }
+            else if(depth == frameDepth)
+            {
+                endFrame();
+            }
+        }
+        depth--;
+        return !cancelled;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& ex) override
+    {
+        // A cancelled read cuts the input short, which is no fault of the file
+        if(!cancelled)
+        {
+            qWarning() << "Couldn't parse save file at byte" << position << ":" << ex.what();
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief FrameRange is the byte range of one frame's array inside a mapped project
+ */
+struct FrameRange
+{
+    int index;
+    const char* begin;
+    const char* end;
+    QImage image;
+    bool decoded;
+};
+
+static const char* skipWhitespace(const char* p, const char* end)
+{
+    while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief scanProject walks the structure of a JSON project without tokenizing numbers,
+ * recording where each frame's array starts and ends, the stored dimensions and how rows
+ * are encoded
+ * @return false if the brackets or strings of the document don't balance, or the file is
+ * of a schema the scan doesn't understand
+ */
+static bool scanProject(const char* data, qint64 size, std::vector<FrameRange>& ranges, int& width, int& height,
+                        Frame::RowEncoding& rowEncoding)
+{
+    const char* end = data + size;
+    int depth = 0;
+    bool inFrames = false;
+    int pendingIndex = -1;
+    const char* valueStart = nullptr;
+    std::string rootKey;
+
+    for(const char* p = data; p < end; p++)
+    {
+        switch(*p)
+        {
+        case '"':
+        {
+            const char* keyStart = ++p;
+            while(p < end && *p != '"')
+            {
+                p += *p == '\\' ? 2 : 1;
+            }
+            if(p >= end)
+            {
+                return false;
+            }
+            const char* colon = skipWhitespace(p + 1, end);
+            if(colon == end || *colon != ':')
+            {
+                break;
+            }
+            std::string key(keyStart, p - keyStart);
+            const char* value = skipWhitespace(colon + 1, end);
+            if(depth == 1)
+            {
+                rootKey = key;
+                std::string number(value, std::min<qint64>(end - value, 12));
+                if(key == "width")
+                {
+                    width = atoi(number.c_str());
+                }
+                else if(key == "height")
+                {
+                    height = atoi(number.c_str());
+                }
+                else if(key == "version" && atoi(number.c_str()) > schemaVersion)
+                {
+                    return false;
+                }
+                else if(key == "rowEncoding")
+                {
+                    if(number.compare(0, 5, "\"hex\"") == 0)
+                    {
+                        rowEncoding = Frame::HexRows;
+                    }
+                    else if(number.compare(0, 8, "\"base64\"") == 0)
+                    {
+                        rowEncoding = Frame::Base64Rows;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if(depth == 2 && inFrames && key.compare(0, 5, "frame") == 0 && value < end && *value == '[')
+            {
+                pendingIndex = atoi(key.c_str() + 5);
+                valueStart = value;
+            }
+            p = colon;
+            break;
+        }
+        case '{':
+        case '[':
+            depth++;
+            if(depth == 2 && rootKey == "frames" && *p == '{')
+            {
+                inFrames = true;
+            }
+            break;
+        case '}':
+        case ']':
+            depth--;
+            if(depth == 2 && valueStart != nullptr)
+            {
+                if(pendingIndex >= 0 && pendingIndex <= maxFrameIndex)
+                {
+                    ranges.push_back(FrameRange{pendingIndex, valueStart, p + 1, QImage(), false});
+                }
+                valueStart = nullptr;
+            }
+            else if(depth == 1)
+            {
+                inFrames = false;
+            }
+            else if(depth < 0)
+            {
+                return false;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return depth == 0;
+}
+
+/**
+ * @brief readParallel splits a mapped project into frames and decodes them concurrently
+ * on the global thread pool
+ * @param cancelled set if progress cancelled the read
+ * @return false if the file couldn't be split, in which case the streaming reader is used,
+ * or if the read was cancelled
+ */
+static bool readParallel(const char* data, qint64 size, std::vector<Frame>& frames, int& width, int& height,
+                         const ReadProgress* progress, bool& cancelled)
+{
+    std::vector<FrameRange> ranges;
+    int storedWidth = 0;
+    int storedHeight = 0;
+    Frame::RowEncoding rowEncoding = Frame::HexRows;
+    if(!scanProject(data, size, ranges, storedWidth, storedHeight, rowEncoding) || ranges.empty()
+            || storedWidth <= 0 || storedHeight <= 0)
+    {
+        return false;
+    }
+
+    // Progress counts the bytes of every frame decoded so far, whichever thread decoded it
+    std::atomic<qint64> bytesRead(0);
+    std::atomic<int> framesDecoded(0);
+    std::atomic<bool> stopped(false);
+    QtConcurrent::blockingMap(ranges, [&, storedWidth, storedHeight, rowEncoding](FrameRange& range){
+        if(stopped)
+        {
+            range.decoded = false;
+            return;
+        }
+        ProjectSaxHandler handler(storedWidth, storedHeight, rowEncoding);
+        range.decoded = json::sax_parse(range.begin, range.end, &handler) && !handler.images.empty();
+        if(range.decoded)
+        {
+            range.image = handler.images[0];
+        }
+        if(progress != nullptr)
+        {
+            if(range.index == 0 && range.decoded)
+            {
+                progress->reportFirstFrame(range.image);
+            }
+            if(!progress->report(bytesRead += range.end - range.begin, ++framesDecoded))
+            {
+                stopped = true;
+            }
+        }
+    });
+    if(stopped)
+    {
+        cancelled = true;
+        return false;
+    }
+
+    int frameCount = 0;
+    for(const FrameRange& range : ranges)
+    {
+        if(!range.decoded)
+        {
+            return false;
+        }
+        frameCount = std::max(frameCount, range.index + 1);
+    }
+
+    std::vector<QImage> images(frameCount);
+    for(FrameRange& range : ranges)
+    {
+        images[range.index] = range.image;
+    }
+    width = storedWidth;
+    height = storedHeight;
+    frames.clear();
+    frames.reserve(frameCount);
+    for(QImage& image : images)
+    {
+        frames.push_back(image.isNull() ? Frame(width, height) : Frame(image));
+    }
+    return true;
+}
+
+JsonProject::Encoding JsonProject::detectEncoding(const QByteArray& leadingBytes)
+{
+    if(leadingBytes.size() >= 3 && memcmp(leadingBytes.constData(), cborTag, 3) == 0)
+    {
+        return CborEncoding;
+    }
+    // Every project is a map, which MessagePack starts with a fixmap, map16 or map32 byte
+    const uchar first = leadingBytes.isEmpty() ? 0 : (uchar)leadingBytes[0];
+    if((first & 0xf0) == 0x80 || first == 0xde || first == 0xdf)
+    {
+        return MessagePackEncoding;
+    }
+    return TextEncoding;
+}
+
+/**
+ * @brief unpackFrames expands the byte string frames of a CBOR or MessagePack project into
+ * images, concurrently on the global thread pool
+ * @return false if a frame doesn't hold width * height pixels, or the read was cancelled
+ */
+static bool unpackFrames(ProjectSaxHandler& handler, int width, int height)
+{
+    for(const ProjectSaxHandler::PackedFrame& packed : handler.packedFrames)
+    {
+        if(packed.bytes.size() != (size_t)width * height * 4)
+        {
+            return false;
+        }
+        if(packed.index >= (int)handler.images.size())
+        {
+            handler.images.resize(packed.index + 1);
+        }
+    }
+    std::vector<QImage>& images = handler.images;
+    const ReadProgress* progress = handler.progress;
+    const qint64 bytesRead = handler.bytesRead;
+    std::atomic<int> framesDecoded(0);
+    std::atomic<bool> stopped(false);
+    QtConcurrent::blockingMap(handler.packedFrames, [&, width, height](ProjectSaxHandler::PackedFrame& packed){
+        if(stopped)
+        {
+            return;
+        }
+        Frame frame(width, height);
+        frame.readRgba(packed.bytes.data());
+        images[packed.index] = frame.getImage();
+        std::vector<std::uint8_t>().swap(packed.bytes);
+        if(progress != nullptr)
+        {
+            if(packed.index == 0)
+            {
+                progress->reportFirstFrame(images[0]);
+            }
+            if(!progress->report(bytesRead, ++framesDecoded))
+            {
+                stopped = true;
+            }
+        }
+    });
+    handler.packedFrames.clear();
+    return !stopped;
+}
+
+bool JsonProject::read(QIODevice& device, std::vector<Frame>& frames, int& width, int& height,
+                       const ReadProgress* progress)
+{
+    const Encoding encoding = detectEncoding(device.peek(sizeof(cborTag)));
+
+    // Text files are mapped and split so frames decode in parallel; anything else is streamed
+    QFileDevice* file = qobject_cast<QFileDevice*>(&device);
+    if(encoding == TextEncoding && file != nullptr && file->size() > 0)
+    {
+        uchar* data = file->map(0, file->size());
+        if(data != nullptr)
+        {
+            bool cancelled = false;
+            bool loaded = readParallel((const char*)data, file->size(), frames, width, height, progress, cancelled);
+            file->unmap(data);
+            if(loaded)
+            {
+                return true;
+            }
+            if(cancelled)
+            {
+                frames.clear();
+                return false;
+            }
+        }
+        device.seek(0);
+    }
+
+    nlohmann::detail::input_format_t format = nlohmann::detail::input_format_t::json;
+    if(encoding == CborEncoding)
+    {
+        // json.hpp rejects tags by default, so the self-describe tag is skipped here
+        device.read(sizeof(cborTag));
+        format = nlohmann::detail::input_format_t::cbor;
+    }
+    else if(encoding == MessagePackEncoding)
+    {
+        format = nlohmann::detail::input_format_t::msgpack;
+    }
+
+    ProjectSaxHandler handler;
+    handler.progress = progress;
+    DeviceBuffer buffer(&device, [&handler](qint64 bytesRead){
+        handler.bytesRead = bytesRead;
+        return handler.reportProgress();
+    });
+    if(!json::sax_parse(DeviceIterator(&buffer), DeviceIterator(), &handler, format))
+    {
+        frames.clear();
+        return false;
+    }
+    if(handler.version > schemaVersion)
+    {
+        qWarning("Save file was written by a newer version of the editor.");
+        frames.clear();
+        return false;
+    }
+
+    // Legacy projects are square and the editor has always sized them by "height"
+    height = handler.height > 0 ? handler.height : handler.frameHeight;
+    width = handler.width > 0 ? handler.width : handler.frameWidth;
+    if(width <= 0 || height <= 0 || !unpackFrames(handler, width, height))
+    {
+        frames.clear();
+        return false;
+    }
+
+    frames.clear();
+    frames.reserve(handler.images.size());
+    for(QImage& image : handler.images)
+    {
+        if(image.isNull())
+        {
+            frames.push_back(Frame(width, height));
+        }
+        else if(image.width() != width || image.height() != height)
+        {
+            frames.push_back(Frame(image.copy(0, 0, width, height)));
+        }
+        else
+        {
+            frames.push_back(Frame(image));
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief appendMapHeader appends the header of a map with the given number of entries; the
+ * one piece of the document json.hpp can't encode on its own without the whole map in memory
+ */
+static void appendMapHeader(QByteArray& buffer, JsonProject::Encoding encoding, quint32 count)
+{
+    uchar header[5];
+    int length;
+    if(encoding == JsonProject::CborEncoding)
+    {
+        if(count < 24)
+        {
+            header[0] = 0xa0 | count;
+            length = 1;
+        }
+        else if(count <= 0xff)
+        {
+            header[0] = 0xb8;
+            header[1] = count;
+            length = 2;
+        }
+        else if(count <= 0xffff)
+        {
+            header[0] = 0xb9;
+            qToBigEndian<quint16>(count, header + 1);
+            length = 3;
+        }
+        else
+        {
+            header[0] = 0xba;
+            qToBigEndian<quint32>(count, header + 1);
+            length = 5;
+        }
+    }
+    else
+    {
+        if(count < 16)
+        {
+            header[0] = 0x80 | count;
+            length = 1;
+        }
+        else if(count <= 0xffff)
+        {
+            header[0] = 0xde;
+            qToBigEndian<quint16>(count, header + 1);
+            length = 3;
+        }
+        else
+        {
+            header[0] = 0xdf;
+            qToBigEndian<quint32>(count, header + 1);
+            length = 5;
+        }
+    }
+    buffer.append((const char*)header, length);
+}
+
+/**
+ * @brief appendValue appends a value encoded by json.hpp in the given binary encoding
+ */
+static void appendValue(QByteArray& buffer, JsonProject::Encoding encoding, const json& value)
+{
+    std::vector<std::uint8_t> encoded;
+    if(encoding == JsonProject::CborEncoding)
+    {
+        json::to_cbor(value, encoded);
+    }
+    else
+    {
+        json::to_msgpack(value, encoded);
+    }
+    buffer.append((const char*)encoded.data(), (int)encoded.size());
+}
+
+/**
+ * @brief writePacked writes the project in CBOR or MessagePack. The maps are framed by hand
+ * so frames can still be encoded concurrently and streamed out one at a time
+ */
+static bool writePacked(QIODevice& device, const std::vector<Frame>& frames, int width, int height,
+                        JsonProject::Encoding encoding)
+{
+    const int frameCount = (int)frames.size();
+    QByteArray buffer;
+    if(encoding == JsonProject::CborEncoding)
+    {
+        buffer.append(cborTag, sizeof(cborTag));
+    }
+    appendMapHeader(buffer, encoding, 4);
+    appendValue(buffer, encoding, "frames");
+    appendMapHeader(buffer, encoding, frameCount);
+    if(device.write(buffer) != buffer.size())
+    {
+        return false;
+    }
+
+    bool written = encodeFramesInOrder(device, frameCount,
+        [&frames, encoding](int frameIndex, QByteArray& frameBuffer){
+            const Frame& frame = frames[frameIndex];
+            std::vector<std::uint8_t> pixels(frame.rawSize());
+            frame.writeRgba(pixels.data());
+            appendValue(frameBuffer, encoding, "frame" + std::to_string(frameIndex));
+            appendValue(frameBuffer, encoding, json::binary(std::move(pixels)));
+        },
+        [](int, const QByteArray&){});
+    if(!written)
+    {
+        return false;
+    }
+
+    buffer.clear();
+    appendValue(buffer, encoding, "height");
+    appendValue(buffer, encoding, height);
+    appendValue(buffer, encoding, "numberOfFrames");
+    appendValue(buffer, encoding, frameCount);
+    appendValue(buffer, encoding, "width");
+    appendValue(buffer, encoding, width);
+    return device.write(buffer) == buffer.size();
+}
+
+bool JsonProject::write(QIODevice& device, const std::vector<Frame>& frames, int width, int height,
+                        Encoding encoding)
+{
+    // Lazily opened frames are decoded up front so the encoders never race to load them
+    Frame::loadAll(frames);
+    if(encoding == CborEncoding || encoding == MessagePackEncoding)
+    {
+        return writePacked(device, frames, width, height, encoding);
+    }
+    const int frameCount = (int)frames.size();
+    const bool rows = encoding != TextEncoding;
+    const Frame::RowEncoding rowEncoding = encoding == HexRowsEncoding ? Frame::HexRows : Frame::Base64Rows;
+
+    // Version 2 puts the dimensions ahead of the frames so readers never buffer a frame
+    QByteArray buffer("{\n");
+    if(rows)
+    {
+        buffer.append("    \"version\": ");
+        buffer.append(QByteArray::number(schemaVersion));
+        buffer.append(",\n    \"rowEncoding\": ");
+        buffer.append(rowEncoding == Frame::HexRows ? "\"hex\"" : "\"base64\"");
+        buffer.append(",\n    \"height\": ");
+        buffer.append(QByteArray::number(height));
+        buffer.append(",\n    \"numberOfFrames\": ");
+        buffer.append(QByteArray::number(frameCount));
+        buffer.append(",\n    \"width\": ");
+        buffer.append(QByteArray::number(width));
+        buffer.append(",\n");
+    }
+    buffer.append("    \"frames\": {\n");
+    if(device.write(buffer) != buffer.size())
+    {
+        return false;
+    }
+
+    bool written = encodeFramesInOrder(device, frameCount,
+        [&frames, frameCount, rows, rowEncoding](int frameIndex, QByteArray& frameBuffer){
+            frameBuffer.append("        \"frame");
+            frameBuffer.append(QByteArray::number(frameIndex));
+            frameBuffer.append("\": ");
+            if(rows)
+            {
+                frames[frameIndex].writeRows(frameBuffer, rowEncoding);
+            }
+            else
+            {
+                frames[frameIndex].write(frameBuffer);
+            }
+            frameBuffer.append(frameIndex != frameCount - 1 ? ",\n" : "\n");
+        },
+        [](int, const QByteArray&){});
+    if(!written)
+    {
+        return false;
+    }
+
+    if(rows)
+    {
+        buffer = "    }\n}\n";
+        return device.write(buffer) == buffer.size();
+    }
+    buffer = "    },\n    \"height\": ";
+    buffer.append(QByteArray::number(height));
+    buffer.append(",\n    \"numberOfFrames\": ");
+    buffer.append(QByteArray::number(frameCount));
+    buffer.append(",\n    \"width\": ");
+    buffer.append(QByteArray::number(width));
+    buffer.append("\n}\n");
+    return device.write(buffer) == buffer.size();
+}
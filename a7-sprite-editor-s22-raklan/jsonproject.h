@@ -0,0 +1,80 @@
+#ifndef JSONPROJECT_H
+#define JSONPROJECT_H
+
+#include <QIODevice>
+#include <vector>
+#include "frame.h"
+#include "readprogress.h"
+
+/**
+ * @brief JsonProject reads and writes the JSON flavour of the .ssp format, the format every
+ * project was saved in before the binary container existed. The schema is
+ *
+ *   { "frames": { "frame0": [ [ [r, g, b, a], ... ], ... ], ... },
+ *     "height": h, "numberOfFrames": n, "width": w }
+ *
+ * Files are parsed with the SAX interface of the vendored nlohmann json.hpp, so pixels are
+ * written into each frame's scanlines as the tokens arrive and no document is ever built.
+ * Writing is streamed the same way, one frame's text at a time.
+ *
+ * Version 2 of the schema stores each row as a single string of the row's r, g, b, a bytes,
+ * hex or base64 encoded as named by "rowEncoding". The dimensions are written ahead of the
+ * frames so readers know them before the first row arrives:
+ *
+ *   { "version": 2, "rowEncoding": "hex", "height": h, "numberOfFrames": n, "width": w,
+ *     "frames": { "frame0": [ "rrggbbaa...", ... ], ... } }
+ *
+ * The same schema can also be stored in CBOR or MessagePack. There each frame is a single
+ * byte string of r, g, b, a bytes, row by row, instead of nested integer arrays. CBOR files
+ * start with the self-describe tag D9 D9 F7; MessagePack files with a map header.
+ */
+class JsonProject
+{
+public:
+    /**
+     * @brief The Encoding enum selects how the project document is serialized
+     */
+    enum Encoding{
+        TextEncoding,
+        CborEncoding,
+        MessagePackEncoding,
+        HexRowsEncoding,
+        Base64RowsEncoding
+    };
+
+    /**
+     * @brief detectEncoding tells the encodings apart by the first bytes of a file
+     * @param leadingBytes at least the first three bytes of the file
+     * @return the encoding the file should be parsed with; TextEncoding for any text file,
+     * whichever version of the schema it uses
+     */
+    static Encoding detectEncoding(const QByteArray& leadingBytes);
+
+    /**
+     * @brief read streams a JSON project in any of the encodings from the device into frames
+     * @param device an open, readable device positioned at the start of the document
+     * @param frames cleared, then filled with one Frame per frame in the file
+     * @param width set to the width of the frames
+     * @param height set to the height of the frames
+     * @param progress if given, told of the bytes read and frames decoded as the read goes on
+     * @return a true/false on whether the file was a valid JSON project and the read wasn't
+     * cancelled
+     */
+    static bool read(QIODevice& device, std::vector<Frame>& frames, int& width, int& height,
+                     const ReadProgress* progress = nullptr);
+
+    /**
+     * @brief write streams the frames to the device as a JSON project. Text is indented in
+     * the same layout QJsonDocument produces
+     * @param device an open, writable device
+     * @param frames the frames of the Sprite, in order
+     * @param width the width of every frame
+     * @param height the height of every frame
+     * @param encoding how the document is serialized
+     * @return a true/false on whether every byte could be written
+     */
+    static bool write(QIODevice& device, const std::vector<Frame>& frames, int width, int height,
+                      Encoding encoding = TextEncoding);
+};
+
+#endif // JSONPROJECT_H
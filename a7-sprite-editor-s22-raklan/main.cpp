@@ -4,11 +4,133 @@
 #include "frame.h"
 #include "model.h"
 #include "mainmenu.h"
+#include "projectfile.h"
+#include "jsonproject.h"
+#include "videostream.h"
+#include "pixelscaler.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <cstdio>
+
+/**
+ * @brief readNumber reads a whole number option of the command line
+ * @param value set to the option's value, if it is a number from minimum to maximum
+ * @return a true/false on whether it was
+ */
+static bool readNumber(const QCommandLineParser& parser, const QCommandLineOption& option,
+                       int minimum, int maximum, int& value)
+{
+    bool ok;
+    value = parser.value(option).toInt(&ok);
+    if(!ok || value < minimum || value > maximum)
+    {
+        qWarning("--%s must be a whole number from %d to %d.", qPrintable(option.names().first()), minimum, maximum);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief exportVideo streams a project as video from the command line, so it can be piped
+ * straight into an encoder:
+ *   LeSporkEditor --export-video - --scale 8 --fps 12 walk.ssp | ffmpeg -i - walk.mp4
+ * @param app the application, holding the command line
+ * @return the exit code of the program
+ */
+static int exportVideo(const QCoreApplication& app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Streams a Sprite as YUV4MPEG2 or raw RGBA video.");
+    parser.addHelpOption();
+    QCommandLineOption outputOption("export-video", "Write the stream to <file>, or to stdout if <file> is -.", "file");
+    QCommandLineOption formatOption("format", "y4m, rgba or raw (the same as rgba); by default taken from the file's suffix, y4m for stdout.", "format");
+    QCommandLineOption scaleOption("scale", "Make every frame <factor> times larger, from 1 to 16.", "factor", "1");
+    QCommandLineOption fpsOption("fps", "Play <fps> frames per second, from 1 to 1000.", "fps", "3");
+    QCommandLineOption loopsOption("loops", "Play the animation <count> times, from 1 to 1000.", "count", "1");
+    parser.addOptions({outputOption, formatOption, scaleOption, fpsOption, loopsOption});
+    parser.addPositionalArgument("project", "The Sprite to export.");
+    parser.process(app);
+    if(parser.positionalArguments().size() != 1)
+    {
+        parser.showHelp(1);
+    }
+
+    QString outputPath = parser.value(outputOption);
+    VideoStream::Options options;
+    options.format = VideoStream::formatForPath(outputPath);
+    if(parser.isSet(formatOption))
+    {
+        const QString format = parser.value(formatOption);
+        if(format != "y4m" && format != "rgba" && format != "raw")
+        {
+            qWarning("--format must be y4m, rgba or raw.");
+            return 1;
+        }
+        options.format = format == "y4m" ? VideoStream::Y4mFormat : VideoStream::RawRgbaFormat;
+    }
+    if(!readNumber(parser, scaleOption, 1, PixelScaler::maxFactor, options.scale)
+            || !readNumber(parser, fpsOption, 1, 1000, options.fps)
+            || !readNumber(parser, loopsOption, 1, 1000, options.loops))
+    {
+        return 1;
+    }
+
+    QString projectPath = parser.positionalArguments().first();
+    QFile projectFile(projectPath);
+    if(!projectFile.open(QIODevice::ReadOnly))
+    {
+        qWarning("Couldn't open %s.", qPrintable(projectPath));
+        return 1;
+    }
+    std::vector<Frame> frames;
+    int width;
+    int height;
+    bool read = ProjectFile::isBinaryProject(projectFile.peek(4)) ? ProjectFile::read(projectFile, frames, width, height)
+                                                                  : JsonProject::read(projectFile, frames, width, height);
+    if(!read)
+    {
+        qWarning("Couldn't read %s.", qPrintable(projectPath));
+        return 1;
+    }
+
+    QFile output;
+    bool opened;
+    if(outputPath == "-")
+    {
+        opened = output.open(stdout, QIODevice::WriteOnly);
+    }
+    else
+    {
+        output.setFileName(outputPath);
+        opened = output.open(QIODevice::WriteOnly);
+    }
+    if(!opened)
+    {
+        qWarning("Couldn't open %s for writing.", qPrintable(outputPath));
+        return 1;
+    }
+    if(!VideoStream::write(output, frames, options) || !output.flush())
+    {
+        qWarning("Couldn't write the video stream.");
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    // Exporting from the command line opens no windows, so it runs without a display
+    for(int i = 1; i < argc; i++)
+    {
+        if(QString(argv[i]).startsWith("--export-video"))
+        {
+            QCoreApplication app(argc, argv);
+            return exportVideo(app);
+        }
+    }
+
     QApplication a(argc, argv);
     MainMenu mainMenu;
     mainMenu.show();
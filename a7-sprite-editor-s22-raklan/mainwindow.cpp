@@ -2,12 +2,51 @@
 #include "ui_mainwindow.h"
 #include <QMouseEvent>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QColorDialog>
+#include <QInputDialog>
+#include <QGridLayout>
 #include "canvas.h"
+#include "pixelscaler.h"
 #include "model.h"
+#include "projectpreview.h"
 
 #include <QDebug>
 
+/**
+ * @brief getExportFileName asks where to export to. Exports are told apart by the file's
+ * suffix, so a name typed without one gets the suffix of the selected filter
+ * @param parent the window the dialog belongs to
+ * @param caption the title of the dialog
+ * @param filters each filter of the dialog and the suffix it adds
+ * @return the chosen path, or an empty string if the dialog was cancelled
+ */
+static QString getExportFileName(QWidget* parent, const QString& caption,
+                                 const std::vector<std::pair<QString, QString>>& filters)
+{
+    QStringList filterNames;
+    for(const auto& filter : filters)
+    {
+        filterNames.append(filter.first);
+    }
+
+    QString selectedFilter;
+    QString filePath = QFileDialog::getSaveFileName(parent, caption, "/home/.",
+                                                    filterNames.join(";;"), &selectedFilter);
+    if(filePath.isEmpty() || !QFileInfo(filePath).suffix().isEmpty())
+    {
+        return filePath;
+    }
+    for(const auto& filter : filters)
+    {
+        if(filter.first == selectedFilter)
+        {
+            return filePath + filter.second;
+        }
+    }
+    return filePath;
+}
+
 MainWindow::MainWindow(Model& _model, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
@@ -18,6 +57,16 @@ MainWindow::MainWindow(Model& _model, QWidget *parent)
     previewGraphic = new QGraphicsScene(this);
     onionGraphic = new QGraphicsScene(this);
 
+    // Shown only while a project is being read on a worker thread
+    loadProgressBar = new QProgressBar(this);
+    loadProgressBar->setRange(0, 1000);
+    loadProgressBar->setMaximumWidth(200);
+    cancelLoadButton = new QPushButton("Cancel", this);
+    ui->statusbar->addPermanentWidget(loadProgressBar);
+    ui->statusbar->addPermanentWidget(cancelLoadButton);
+    loadProgressBar->setVisible(model->isLoading());
+    cancelLoadButton->setVisible(model->isLoading());
+
     setupSignalsAndSlots();
     setupCanvas();
 }
@@ -49,9 +98,7 @@ void MainWindow::setupSignalsAndSlots()
 
     /*===SAVING LOADING & EXPORTING===*/
     //=View=
-    auto menuActions = ui->menuFile->actions();
-    QAction* exportAction = menuActions.back();
-    connect(exportAction,
+    connect(ui->actionExport,
             &QAction::triggered,
             this,
             &MainWindow::on_exportMenu_Action);
@@ -72,6 +119,34 @@ void MainWindow::setupSignalsAndSlots()
             &MainWindow::exportFame,
             model,
             &Model::exportFame);
+    connect(this,
+            &MainWindow::exportSpriteSheet,
+            model,
+            &Model::exportSpriteSheet);
+    connect(this,
+            &MainWindow::exportAllFrames,
+            model,
+            &Model::exportAllFrames);
+    connect(this,
+            &MainWindow::exportAnimation,
+            model,
+            &Model::exportAnimation);
+    connect(this,
+            &MainWindow::exportEngineData,
+            model,
+            &Model::exportEngineData);
+    connect(this,
+            &MainWindow::exportVideo,
+            model,
+            &Model::exportVideo);
+    connect(this,
+            &MainWindow::autosaveIntervalChanged,
+            model,
+            &Model::setAutosaveInterval);
+    connect(this,
+            &MainWindow::exportScaleChanged,
+            model,
+            &Model::setExportScale);
 
     /*===MODEL UPDATES FROM VIEW===*/
     connect(ui->disablePreviewScaling,
@@ -112,6 +187,30 @@ void MainWindow::setupSignalsAndSlots()
             &Model::updateNumberOfFrames,
             this,
             &MainWindow::updateNumberOfFrames);
+    connect(model,
+            &Model::autosaved,
+            this,
+            &MainWindow::autosaved);
+    connect(model,
+            &Model::framesExported,
+            this,
+            &MainWindow::framesExported);
+    connect(model,
+            &Model::loadProgress,
+            this,
+            &MainWindow::loadProgress);
+    connect(model,
+            &Model::loadFinished,
+            this,
+            &MainWindow::loadFinished);
+    connect(model,
+            &Model::frameSizeChanged,
+            this,
+            &MainWindow::frameSizeChanged);
+    connect(cancelLoadButton,
+            &QPushButton::clicked,
+            model,
+            &Model::cancelLoading);
 
     /*===MISC===*/
     connect(ui->previewFPSSlider,
@@ -231,6 +330,63 @@ void MainWindow::updateNumberOfFrames(QString frameSize)
     ui->TotalFrames->setText(frameSize);
 }
 
+void MainWindow::autosaved(QString filePath, bool saved)
+{
+    if(saved)
+    {
+        ui->statusbar->showMessage("Autosaved to " + filePath, 5000);
+    }
+    else
+    {
+        ui->statusbar->showMessage("Autosave to " + filePath + " failed");
+    }
+}
+
+void MainWindow::framesExported(QString filePath, bool exported)
+{
+    if(exported)
+    {
+        ui->statusbar->showMessage("Exported to " + filePath, 5000);
+    }
+    else
+    {
+        ui->statusbar->showMessage("Exporting to " + filePath + " failed");
+    }
+}
+
+void MainWindow::loadProgress(qint64 bytesRead, qint64 totalBytes, int framesDecoded)
+{
+    if(totalBytes > 0)
+    {
+        loadProgressBar->setValue((int)(qMin(bytesRead, totalBytes) * 1000 / totalBytes));
+    }
+    ui->statusbar->showMessage("Opening... " + QString::number(framesDecoded) + " frames decoded");
+}
+
+void MainWindow::loadFinished(bool loaded)
+{
+    loadProgressBar->hide();
+    cancelLoadButton->hide();
+    if(loaded)
+    {
+        ui->statusbar->showMessage("Opened project", 5000);
+    }
+    else
+    {
+        ui->statusbar->showMessage("Couldn't open project");
+    }
+}
+
+void MainWindow::frameSizeChanged(int frameSize)
+{
+    // ScaleCanvas and ScaleOnionSkin scale on top of the current transform
+    ui->canvasView->resetTransform();
+    ui->onionSkin->resetTransform();
+    ScaleCanvas();
+    ScaleOnionSkin();
+    ui->canvasView->centerOn(QPointF(frameSize/2, frameSize/2));
+}
+
 void MainWindow::on_penButton_clicked()
 {
     highlightButton(PenButton);
@@ -317,24 +473,214 @@ void MainWindow::on_nextFrame_clicked()
 
 void MainWindow::on_saveMenu_Action()
 {
-    QString filePath = QFileDialog::getSaveFileName(this, "Save Project","/home/.", "SSP (*.ssp)");
-    emit saveProject(filePath);
+    // Each filter of the dialog saves the project in a different format
+    const std::vector<std::pair<QString, ProjectFormat>> formats = {
+        {"SSP (*.ssp)", BinaryFormat},
+        {"SSP Compressed (*.ssp)", CompressedBinaryFormat},
+        {"SSP JSON (*.ssp)", JsonFormat},
+        {"SSP CBOR (*.ssp)", CborFormat},
+        {"SSP MessagePack (*.ssp)", MessagePackFormat},
+        {"SSP JSON Hex Rows (*.ssp)", JsonHexRowsFormat},
+        {"SSP JSON Base64 Rows (*.ssp)", JsonBase64RowsFormat}
+    };
+    QStringList filters;
+    for(const auto& format : formats)
+    {
+        filters.append(format.first);
+    }
+
+    QString selectedFilter;
+    QString filePath = QFileDialog::getSaveFileName(this, "Save Project","/home/.",
+                                                    filters.join(";;"), &selectedFilter);
+    if(filePath.isEmpty())
+    {
+        return;
+    }
+    for(const auto& format : formats)
+    {
+        if(format.first == selectedFilter)
+        {
+            emit saveProject(filePath, format.second);
+            return;
+        }
+    }
+    emit saveProject(filePath, BinaryFormat);
 }
 
 void MainWindow::on_openMenu_Action()
 {
-    QString filePath = QFileDialog::getOpenFileName(this, "Open Project","/home/.", "SSP (*.ssp)");
+    // Qt's own dialog is used so projects can be listed with their thumbnails; the icon
+    // provider is declared first so it outlives the dialog's file system model
+    ProjectIconProvider iconProvider;
+    QFileDialog dialog(this, "Open Project", "/home/.", "SSP (*.ssp)");
+    dialog.setFileMode(QFileDialog::ExistingFile);
+    dialog.setOption(QFileDialog::DontUseNativeDialog);
+    dialog.setIconProvider(&iconProvider);
+    ProjectPreview* preview = new ProjectPreview(&dialog);
+    QGridLayout* layout = qobject_cast<QGridLayout*>(dialog.layout());
+    if(layout != nullptr)
+    {
+        layout->addWidget(preview, 0, layout->columnCount(), layout->rowCount(), 1);
+    }
+    connect(&dialog, &QFileDialog::currentChanged, preview, &ProjectPreview::showProject);
+    if(dialog.exec() != QDialog::Accepted || dialog.selectedFiles().isEmpty())
+    {
+        return;
+    }
+
+    QString filePath = dialog.selectedFiles().first();
     Model* newModel = new Model(filePath);
     MainWindow* newMainWindow = new MainWindow(*newModel);
     newMainWindow->show();
 }
 
+void MainWindow::on_actionAutosave_Interval_triggered()
+{
+    bool accepted;
+    int minutes = QInputDialog::getInt(this, "Autosave Interval",
+                                       "Minutes between autosaves (0 turns autosave off):",
+                                       model->getAutosaveInterval(), 0, 120, 1, &accepted);
+    if(accepted)
+    {
+        emit autosaveIntervalChanged(minutes);
+    }
+}
+
+void MainWindow::on_actionExport_Scale_triggered()
+{
+    bool accepted;
+    int scale = QInputDialog::getInt(this, "Export Scale",
+                                     "Export PNG frames and sprite sheets this many times larger:",
+                                     model->getExportScale(), 1, PixelScaler::maxFactor, 1, &accepted);
+    if(accepted)
+    {
+        emit exportScaleChanged(scale);
+    }
+}
+
+void MainWindow::on_actionExport_Sprite_Sheet_triggered()
+{
+    const QStringList layouts = {"Grid", "Grid, trimmed", "Packed", "Packed, trimmed"};
+    bool accepted;
+    QString layout = QInputDialog::getItem(this, "Export Sprite Sheet", "Layout:", layouts, 0, false, &accepted);
+    if(!accepted)
+    {
+        return;
+    }
+
+    QString filePath = getExportFileName(this, "Export Sprite Sheet", {{"PNG (*.png)", ".png"}});
+    if(filePath.isEmpty())
+    {
+        return;
+    }
+
+    SpriteSheet::Options options;
+    options.packing = layout.startsWith("Packed") ? SpriteSheet::ShelfPacking : SpriteSheet::GridPacking;
+    options.trim = layout.endsWith("trimmed");
+    ui->statusbar->showMessage("Exporting sprite sheet...");
+    emit exportSpriteSheet(filePath, options);
+}
+
+void MainWindow::on_actionExport_All_Frames_triggered()
+{
+    bool accepted;
+    int compressionLevel = QInputDialog::getInt(this, "Export All Frames",
+                                                "PNG compression level (0 is fastest, 9 is smallest):",
+                                                6, 0, 9, 1, &accepted);
+    if(!accepted)
+    {
+        return;
+    }
+
+    QString filePath = QFileDialog::getSaveFileName(this, "Export All Frames","/home/.", "PNG (*.png)");
+    if(filePath.isEmpty())
+    {
+        return;
+    }
+    ui->statusbar->showMessage("Exporting frames...");
+    emit exportAllFrames(filePath, compressionLevel);
+}
+
+void MainWindow::on_actionExport_Animation_triggered()
+{
+    QString filePath = getExportFileName(this, "Export Animation", {
+        {"GIF (*.gif)", ".gif"},
+        {"Animated PNG (*.png)", ".png"}
+    });
+    if(filePath.isEmpty())
+    {
+        return;
+    }
+    ui->statusbar->showMessage("Exporting animation...");
+    emit exportAnimation(filePath);
+}
+
+void MainWindow::on_actionExport_Video_triggered()
+{
+    QString filePath = getExportFileName(this, "Export Video", {
+        {"YUV4MPEG2 (*.y4m)", ".y4m"},
+        {"Raw RGBA (*.rgba)", ".rgba"}
+    });
+    if(filePath.isEmpty())
+    {
+        return;
+    }
+    ui->statusbar->showMessage("Exporting video...");
+    emit exportVideo(filePath);
+}
+
+void MainWindow::on_actionExport_Engine_Data_triggered()
+{
+    const std::vector<std::pair<QString, EngineExport::PixelFormat>> formats = {
+        {"RGBA8888", EngineExport::Rgba8888},
+        {"RGB565 (no alpha)", EngineExport::Rgb565},
+        {"Indexed 8-bit (256 colors at most)", EngineExport::Indexed8}
+    };
+    QStringList formatNames;
+    for(const auto& format : formats)
+    {
+        formatNames.append(format.first);
+    }
+    bool accepted;
+    QString formatName = QInputDialog::getItem(this, "Export Engine Data", "Pixel format:", formatNames, 0, false, &accepted);
+    if(!accepted)
+    {
+        return;
+    }
+    QString frameChoice = QInputDialog::getItem(this, "Export Engine Data", "Frames:",
+                                                {"All frames", "Current frame"}, 0, false, &accepted);
+    if(!accepted)
+    {
+        return;
+    }
+
+    QString filePath = getExportFileName(this, "Export Engine Data", {{"Engine Data (*.sspr)", ".sspr"}});
+    if(filePath.isEmpty())
+    {
+        return;
+    }
+    for(const auto& format : formats)
+    {
+        if(format.first == formatName)
+        {
+            ui->statusbar->showMessage("Exporting engine data...");
+            emit exportEngineData(filePath, format.second, frameChoice == "All frames");
+        }
+    }
+}
+
 void MainWindow::on_exportMenu_Action()
 {
-    qDebug() << "Export Triggured \n";
-    QString filePath = QFileDialog::getSaveFileName(this, "Export PNG","/home/.", "PNG (*.png)");
+    QString filePath = getExportFileName(this, "Export Frame", {
+        {"PNG (*.png)", ".png"},
+        {"C/C++ Header (*.h)", ".h"},
+        {"Text (*.txt)", ".txt"}
+    });
+    if(filePath.isEmpty())
+    {
+        return;
+    }
     emit exportFame(filePath);
-    qDebug() << filePath << " ::::: End \n";
 }
 
 void MainWindow::on_action8x8_triggered()
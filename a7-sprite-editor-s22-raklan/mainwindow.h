@@ -7,6 +7,8 @@
 #include <QMessageBox>
 #include <QFile>
 #include <QAction>
+#include <QProgressBar>
+#include <QPushButton>
 #include "model.h"
 
 QT_BEGIN_NAMESPACE
@@ -115,6 +117,41 @@ private slots:
      * @brief Opens a dialog allowing the user to open a previously saved .ssp file for editing
      */
     void on_openMenu_Action();
+    /**
+     * @brief Opens a dialog allowing the user to choose how many minutes pass between
+     * autosaves, or to turn autosave off
+     */
+    void on_actionAutosave_Interval_triggered();
+    /**
+     * @brief Opens a dialog allowing the user to choose how many times larger frames and sprite
+     * sheets are exported
+     */
+    void on_actionExport_Scale_triggered();
+    /**
+     * @brief Asks the user how to lay out a sprite sheet and where to save it, then requests
+     * the Model to export every frame into it
+     */
+    void on_actionExport_Sprite_Sheet_triggered();
+    /**
+     * @brief Asks the user for a PNG compression level and where to save, then requests the
+     * Model to export every frame as a numbered PNG
+     */
+    void on_actionExport_All_Frames_triggered();
+    /**
+     * @brief Asks the user where to save, then requests the Model to export every frame as an
+     * animated GIF or PNG
+     */
+    void on_actionExport_Animation_triggered();
+    /**
+     * @brief Asks the user for a pixel format, which frames and where to save, then requests
+     * the Model to export them for a game engine
+     */
+    void on_actionExport_Engine_Data_triggered();
+    /**
+     * @brief Asks the user where to save, then requests the Model to export the animation as a
+     * video stream
+     */
+    void on_actionExport_Video_triggered();
     /**
      * @brief Opens a new editing window with an 8x8 canvas
      */
@@ -169,6 +206,35 @@ public slots:
      * @param frameSize
      */
     void updateNumberOfFrames(QString frameSize);
+    /**
+     * @brief Tells the user in the status bar that an autosave has finished
+     * @param filePath the file the autosave was written to
+     * @param saved whether the autosave succeeded
+     */
+    void autosaved(QString filePath, bool saved);
+    /**
+     * @brief Shows in the status bar how far the project being opened has been read
+     * @param bytesRead how much of the file has been read
+     * @param totalBytes the size of the file
+     * @param framesDecoded how many frames have been decoded so far
+     */
+    void loadProgress(qint64 bytesRead, qint64 totalBytes, int framesDecoded);
+    /**
+     * @brief Tells the user in the status bar that a background export has finished
+     * @param filePath the exported file, or the filepath the numbered filepaths were made from
+     * @param exported whether every frame was written
+     */
+    void framesExported(QString filePath, bool exported);
+    /**
+     * @brief Hides the load progress and tells the user whether the project was opened
+     * @param loaded whether the project was read
+     */
+    void loadFinished(bool loaded);
+    /**
+     * @brief Rescales the canvas and onion skin for a Sprite of a new size
+     * @param frameSize the new size in pixels of each side of the Sprite
+     */
+    void frameSizeChanged(int frameSize);
 
 signals:
     /**
@@ -188,16 +254,56 @@ signals:
      * @param filePath the filepath to which the frame should be exported
      */
     void exportFame(QString filePath);
+    /**
+     * @brief Requests the Model to export every frame as a sprite sheet at the given filePath
+     * @param filePath the filepath to which the sheet image should be saved
+     * @param options how the sheet is laid out
+     */
+    void exportSpriteSheet(QString filePath, SpriteSheet::Options options);
+    /**
+     * @brief Requests the Model to export every frame as a numbered PNG
+     * @param filePath the filepath the numbered filepaths are made from
+     * @param compressionLevel the zlib level from 0, fastest, to 9, smallest
+     */
+    void exportAllFrames(QString filePath, int compressionLevel);
+    /**
+     * @brief Requests the Model to export every frame as an animated GIF or PNG
+     * @param filePath the filepath at which the .gif or .png file should be saved
+     */
+    void exportAnimation(QString filePath);
+    /**
+     * @brief Requests the Model to export frames for a game engine
+     * @param filePath the filepath at which the blob should be saved
+     * @param format how each pixel is stored
+     * @param allFrames whether to export every frame or only the current one
+     */
+    void exportEngineData(QString filePath, EngineExport::PixelFormat format, bool allFrames);
+    /**
+     * @brief Requests the Model to export the animation as a video stream
+     * @param filePath the filepath at which the stream should be saved
+     */
+    void exportVideo(QString filePath);
     /**
      * @brief Requests the Moddel to save the current Sprite at the given filePath
      * @param filePath the filepath to which the Sprite should be save
+     * @param format the file format the Sprite should be saved as
      */
-    void saveProject(QString filePath);
+    void saveProject(QString filePath, ProjectFormat format);
     /**
      * @brief Requests the Moddel to open the saved file at the given filePath
      * @param filePath the filepath from which the frame should be opened
      */
     void openProject(QString filePath);
+    /**
+     * @brief Requests the Model to autosave at a new interval
+     * @param minutes the minutes between autosaves, 0 turns autosave off
+     */
+    void autosaveIntervalChanged(int minutes);
+    /**
+     * @brief Requests the Model to export images at a new scale
+     * @param scale how many times larger to export, 1 for the frames' own size
+     */
+    void exportScaleChanged(int scale);
 
 private:
     /**
@@ -224,6 +330,14 @@ private:
      * this object is reflected on the onion skin
      */
     QGraphicsScene *onionGraphic;
+    /**
+     * @brief Shows in the status bar how much of the project being opened has been read
+     */
+    QProgressBar *loadProgressBar;
+    /**
+     * @brief Cancels opening the project; shown next to loadProgressBar
+     */
+    QPushButton *cancelLoadButton;
     /**
      * @brief Helper method that calls connect on the various signals and slots
      * required for the program to work.
@@ -1,11 +1,154 @@
 #include "model.h"
 #include "commonDataTypes.h"
 #include "qpainter.h"
+#include "apngencoder.h"
+#include "gifencoder.h"
+#include "pixelscaler.h"
 #include <QTimer>
 #include <QPainter>
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QCoreApplication>
+#include <QtConcurrent>
 #include <queue>
 
+// Compressed saves store a full frame this often and deltas against the previous frame between
+static const int keyframeInterval = 30;
+
+static const int defaultAutosaveMinutes = 2;
+
+/**
+ * @brief writeAutosave writes a snapshot of the frames as a compressed binary project. The file
+ * is written under a temporary name and renamed over the target once complete, so a crash
+ * mid-save never leaves a truncated autosave behind
+ */
+static bool writeAutosave(QString filepath, std::vector<Frame> frames, int frameSize)
+{
+    QSaveFile autosaveFile(filepath);
+    if(!autosaveFile.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    ProjectFile::WriteOptions options;
+    options.compression = ProjectFile::ZlibChunk;
+    options.keyframeInterval = keyframeInterval;
+    options.usePalette = true;
+    return ProjectFile::write(autosaveFile, frames, frameSize, frameSize, options) && autosaveFile.commit();
+}
+
+/**
+ * @brief LoadedProject holds what a worker thread read from a project file until the Model
+ * takes it over
+ */
+struct LoadedProject
+{
+    std::vector<Frame> frames;
+    int width = 0;
+    int height = 0;
+    bool binary = false;
+};
+
+/**
+ * @brief readProject reads the project at filepath into project. Binary projects are mapped and
+ * each frame is decoded when it is first shown; anything else is read as JSON
+ */
+static bool readProject(QString filepath, LoadedProject& project, const ReadProgress& progress)
+{
+    QFile projectFile(filepath);
+    if(!projectFile.open(QIODevice::ReadOnly))
+    {
+        qWarning("Couldn't open save file.");
+        return false;
+    }
+
+    if(ProjectFile::isBinaryProject(projectFile.peek(4)))
+    {
+        projectFile.close();
+        project.binary = true;
+        return ProjectFile::open(filepath, project.frames, project.width, project.height, &progress);
+    }
+    return JsonProject::read(projectFile, project.frames, project.width, project.height, &progress);
+}
+
+/**
+ * @brief numberedPath inserts a frame number before the suffix of filePath, padded so the
+ * files sort in frame order: walk.png becomes walk_001.png for the first of 300 frames
+ */
+static QString numberedPath(QString filePath, int frameNumber, int frameCount)
+{
+    QFileInfo info(filePath);
+    QString suffix = info.suffix().isEmpty() ? QString("png") : info.suffix();
+    QString number = QString::number(frameNumber).rightJustified(qMax(3, (int)QString::number(frameCount).size()), '0');
+    return info.dir().filePath(info.completeBaseName() + "_" + number + "." + suffix);
+}
+
+/**
+ * @brief writeNumberedPNGs writes every frame to its numbered file, encoding as many frames at
+ * once as the global thread pool has threads
+ */
+static bool writeNumberedPNGs(std::vector<Frame> frames, QString filePath, int compressionLevel, int scale)
+{
+    std::vector<int> indices(frames.size());
+    for(int i = 0; i < (int)frames.size(); i++)
+    {
+        indices[i] = i;
+    }
+    std::atomic<bool> exported{true};
+    QtConcurrent::blockingMap(indices, [&](int i){
+        if(!frames[i].exportPNG(numberedPath(filePath, i + 1, (int)frames.size()), compressionLevel, scale))
+        {
+            exported = false;
+        }
+    });
+    return exported;
+}
+
+/**
+ * @brief writeAnimation writes the frames as an animated PNG if the filepath ends in .png and
+ * as a GIF otherwise, under a temporary name renamed over the target once complete
+ */
+static bool writeAnimation(std::vector<Frame> frames, QString filePath, int frameDuration)
+{
+    QSaveFile file(filePath);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    bool written = QFileInfo(filePath).suffix().toLower() == "png" ? ApngEncoder::write(file, frames, frameDuration)
+                                                                     : GifEncoder::write(file, frames, frameDuration);
+    return written && file.commit();
+}
+
+/**
+ * @brief writeEngineData writes the frames as an engine blob, under a temporary name renamed
+ * over the target once complete
+ */
+static bool writeEngineData(std::vector<Frame> frames, QString filePath, EngineExport::PixelFormat format)
+{
+    QSaveFile file(filePath);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    return EngineExport::write(file, frames, format) && file.commit();
+}
+
+/**
+ * @brief writeVideo writes the frames as a video stream, under a temporary name renamed over
+ * the target once complete
+ */
+static bool writeVideo(std::vector<Frame> frames, QString filePath, VideoStream::Options options)
+{
+    QSaveFile file(filePath);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    return VideoStream::write(file, frames, options) && file.commit();
+}
+
 namespace std {
     template <> struct hash<QPoint>
     {
@@ -23,6 +166,11 @@ Model::Model(QObject *parent, int _frameSize)
     frameSize = _frameSize;
     currentTool = Pen;
     frames.push_back(Frame(frameSize, frameSize));
+    savedChunks.push_back(-1);
+    setupAutosave();
+    connect(&exportWatcher, &QFutureWatcher<bool>::finished, this, [this](){
+        emit framesExported(exportTarget, exportWatcher.result());
+    });
     QTimer::singleShot(1000/previewFps, this, &Model::previewController);
 }
 
@@ -30,16 +178,40 @@ Model::Model(QString filepath)
 {
     previewFps = 3;
     currentTool = Pen;
-    // load frames, width, and height:
-    read(filepath);
+    // Binary projects give their size away in the header, so the placeholder shown while the
+    // rest of the file is read already has the right dimensions
+    ProjectFile::Info info;
+    frameSize = ProjectFile::probe(filepath, info) ? info.height : 16;
+    frames.push_back(Frame(frameSize, frameSize));
+    markSaved(QString());
+    setupAutosave();
+    connect(&exportWatcher, &QFutureWatcher<bool>::finished, this, [this](){
+        emit framesExported(exportTarget, exportWatcher.result());
+    });
+    connect(&loadWatcher, &QFutureWatcher<bool>::finished, this, &Model::finishLoading);
+    startLoading(filepath);
     QTimer::singleShot(1000/previewFps, this, &Model::previewController);
-    QTimer::singleShot(500, [this](){emit updateCanvas(frames[currentFrameIndex].getPixMap());});
+    // Queued so the View has connected to updateCanvas by the time the first frame is sent
+    QTimer::singleShot(0, this, [this](){emit updateCanvas(frames[currentFrameIndex].getPixMap());});
 
 }
 
-void Model::saveProject(QString filepath)
+Model::~Model()
 {
-    write(filepath);
+    loadCancelled = true;
+    loadWatcher.waitForFinished();
+    autosaveWatcher.waitForFinished();
+    exportWatcher.waitForFinished();
+}
+
+void Model::saveProject(QString filepath, ProjectFormat format)
+{
+    if(loading)
+    {
+        qWarning("Can't save while the project is still loading.");
+        return;
+    }
+    write(filepath, format);
 }
 
 QPixmap Model::getOnionSkinPixmap(int framesIndex)
@@ -240,6 +412,11 @@ void Model::ovalTool(QPoint startPos, QPoint endPos, QColor paintColor)
 
 void Model::mouseUsed(QMouseEvent *event)
 {
+    // Edits to the placeholder would be thrown away once the loaded frames replace it
+    if(loading)
+    {
+        return;
+    }
     QPoint clickedPoint = getScaledPoint(QPoint(event->position().x(), event->position().y()));
     if(currentTool == Pen)
     {
@@ -317,11 +494,16 @@ void Model::mouseUsed(QMouseEvent *event)
         }
     }
 
+    markChanged(currentFrameIndex);
     emit updateCanvas(frames[currentFrameIndex].getPixMap());
 }
 
 void Model::uiButtonPressed(UIButton buttonPressed)
 {
+    if(loading)
+    {
+        return;
+    }
     isDrawingShape = false;
     switch(buttonPressed)
     {
@@ -343,6 +525,8 @@ void Model::uiButtonPressed(UIButton buttonPressed)
         case AddFrameButton:
             //Checking if the current Frame is seperate from the frames one
             frames.push_back(Frame(frameSize, frameSize));
+            savedChunks.push_back(-1);
+            revision++;
             currentFrameIndex++;
             break;
         case PreviousFrameButton:
@@ -360,7 +544,9 @@ void Model::uiButtonPressed(UIButton buttonPressed)
         case DeleteFrameButton:
             if (currentFrameIndex > 0)
             {
-                frames.erase(std::find(frames.begin(),frames.end(),frames[currentFrameIndex]));
+                frames.erase(frames.begin() + currentFrameIndex);
+                savedChunks.erase(savedChunks.begin() + currentFrameIndex);
+                revision++;
                 currentFrameIndex--;
             }
             break;
@@ -368,6 +554,7 @@ void Model::uiButtonPressed(UIButton buttonPressed)
             for(int y = 0; y < frameSize; y++)
                 for (int x = 0; x < frameSize; x++)
                     frames[currentFrameIndex].setPixel(x, y, Qt::transparent);
+            markChanged(currentFrameIndex);
         break;
 
     }
@@ -472,7 +659,111 @@ int Model::getSize()
 
 void Model::exportFame(QString filePath)
 {
-    frames[currentFrameIndex].exportPNG(filePath);
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    bool exported;
+    if(suffix == "h" || suffix == "hpp")
+    {
+        exported = frames[currentFrameIndex].exportHeader(filePath);
+    }
+    else if(suffix == "txt")
+    {
+        exported = frames[currentFrameIndex].exportText(filePath);
+    }
+    else
+    {
+        exported = frames[currentFrameIndex].exportPNG(filePath, -1, exportScale);
+    }
+    if(!exported)
+    {
+        qWarning("Couldn't export frame.");
+    }
+}
+
+void Model::exportSpriteSheet(QString filePath, SpriteSheet::Options options)
+{
+    if(exportWatcher.isRunning())
+    {
+        qWarning("An export is already running.");
+        return;
+    }
+    exportTarget = filePath;
+    std::vector<Frame> snapshot = frames;
+    options.frameDuration = 1000 / previewFps;
+    options.scale = exportScale;
+    exportWatcher.setFuture(QtConcurrent::run([snapshot, filePath, options](){
+        return SpriteSheet::exportSheet(snapshot, filePath, SpriteSheet::metadataPath(filePath), options);
+    }));
+}
+
+void Model::exportAllFrames(QString filePath, int compressionLevel)
+{
+    if(exportWatcher.isRunning())
+    {
+        qWarning("An export is already running.");
+        return;
+    }
+    exportTarget = filePath;
+    // As with autosave, the copies share the frames' images until the editor paints on them
+    std::vector<Frame> snapshot = frames;
+    const int scale = exportScale;
+    exportWatcher.setFuture(QtConcurrent::run([snapshot, filePath, compressionLevel, scale](){
+        return writeNumberedPNGs(snapshot, filePath, compressionLevel, scale);
+    }));
+}
+
+void Model::exportAnimation(QString filePath)
+{
+    if(exportWatcher.isRunning())
+    {
+        qWarning("An export is already running.");
+        return;
+    }
+    exportTarget = filePath;
+    std::vector<Frame> snapshot = frames;
+    const int frameDuration = 1000 / previewFps;
+    exportWatcher.setFuture(QtConcurrent::run([snapshot, filePath, frameDuration](){
+        return writeAnimation(snapshot, filePath, frameDuration);
+    }));
+}
+
+void Model::exportEngineData(QString filePath, EngineExport::PixelFormat format, bool allFrames)
+{
+    if(exportWatcher.isRunning())
+    {
+        qWarning("An export is already running.");
+        return;
+    }
+    exportTarget = filePath;
+    std::vector<Frame> snapshot;
+    if(allFrames)
+    {
+        snapshot = frames;
+    }
+    else
+    {
+        snapshot.push_back(frames[currentFrameIndex]);
+    }
+    exportWatcher.setFuture(QtConcurrent::run([snapshot, filePath, format](){
+        return writeEngineData(snapshot, filePath, format);
+    }));
+}
+
+void Model::exportVideo(QString filePath)
+{
+    if(exportWatcher.isRunning())
+    {
+        qWarning("An export is already running.");
+        return;
+    }
+    exportTarget = filePath;
+    std::vector<Frame> snapshot = frames;
+    VideoStream::Options options;
+    options.format = VideoStream::formatForPath(filePath);
+    options.scale = exportScale;
+    options.fps = previewFps;
+    exportWatcher.setFuture(QtConcurrent::run([snapshot, filePath, options](){
+        return writeVideo(snapshot, filePath, options);
+    }));
 }
 
 void Model::togglePreviewScaling(bool checked)
@@ -485,71 +776,250 @@ void Model::previewFPSChanged(int value)
     previewFps = value;
 }
 
-void Model::write(QString filepath) const
+void Model::write(QString filepath, ProjectFormat format)
 {
-    QFile projectFile(filepath);
+    ProjectFile::WriteOptions options;
+    options.usePalette = true;
+    if(format == CompressedBinaryFormat)
+    {
+        options.compression = ProjectFile::ZlibChunk;
+        options.keyframeInterval = keyframeInterval;
+    }
+    const bool binaryProject = format == BinaryFormat || format == CompressedBinaryFormat;
+
+    // Saving over the binary project the frames are backed by only appends what changed,
+    // until enough dead space builds up that the file is compacted by a full rewrite
+    if(binaryProject && filepath == journalPath && appendChangedFrames(options))
+    {
+        return;
+    }
+
+    // Frames that haven't been shown yet still decode from the file they were opened from,
+    // which may be the one about to be overwritten; so may the copies a running autosave or
+    // export took of them
+    autosaveWatcher.waitForFinished();
+    exportWatcher.waitForFinished();
+    Frame::loadAll(frames);
+
+    // Written beside the old file and renamed over it, so a failed save leaves the project as
+    // it was
+    QSaveFile projectFile(filepath);
 
     if (!projectFile.open(QIODevice::WriteOnly))
     {
         qWarning("Couldn't open save file.");
+        return;
     }
-    QJsonObject projectObject;
-    projectObject["height"] = frameSize;
-    projectObject["width"] = frameSize;
-    projectObject["numberOfFrames"] = (int)frames.size();
-    QJsonObject framesArray;
 
-    for(int i = 0; i < (int)frames.size(); i++)
+    bool saved;
+    switch(format)
     {
-        frames[i].write(framesArray, i);
+        case BinaryFormat:
+        case CompressedBinaryFormat:
+            saved = ProjectFile::write(projectFile, frames, frameSize, frameSize, options);
+            break;
+        case CborFormat:
+            saved = JsonProject::write(projectFile, frames, frameSize, frameSize, JsonProject::CborEncoding);
+            break;
+        case MessagePackFormat:
+            saved = JsonProject::write(projectFile, frames, frameSize, frameSize, JsonProject::MessagePackEncoding);
+            break;
+        case JsonHexRowsFormat:
+            saved = JsonProject::write(projectFile, frames, frameSize, frameSize, JsonProject::HexRowsEncoding);
+            break;
+        case JsonBase64RowsFormat:
+            saved = JsonProject::write(projectFile, frames, frameSize, frameSize, JsonProject::Base64RowsEncoding);
+            break;
+        default:
+            saved = JsonProject::write(projectFile, frames, frameSize, frameSize);
+            break;
     }
-    projectObject["frames"] = framesArray;
 
-    projectFile.write(QJsonDocument(projectObject).toJson());
+    if(!saved || !projectFile.commit())
+    {
+        qWarning("Couldn't write save file.");
+        markSaved(QString());
+        return;
+    }
+    markSaved(binaryProject ? filepath : QString());
+    projectPath = filepath;
 }
 
-void Model::read(QString filepath)
+bool Model::appendChangedFrames(const ProjectFile::WriteOptions& options)
 {
-    QFile projectFile(filepath);
+    QFile projectFile(journalPath);
+    if(!projectFile.open(QIODevice::ReadWrite) || ProjectFile::needsCompaction(projectFile))
+    {
+        return false;
+    }
+    if(!ProjectFile::append(projectFile, frames, savedChunks, frameSize, frameSize, options))
+    {
+        qWarning("Couldn't append to save file, rewriting it.");
+        return false;
+    }
+    markSaved(journalPath);
+    projectPath = journalPath;
+    return true;
+}
 
-    if (!projectFile.open(QIODevice::ReadOnly)) {
-            qWarning("Couldn't open save file.");
+void Model::markSaved(QString filepath)
+{
+    journalPath = filepath;
+    savedChunks.resize(frames.size());
+    for(int i = 0; i < (int)savedChunks.size(); i++)
+    {
+        savedChunks[i] = i;
     }
+}
 
-    QByteArray saveData = projectFile.readAll();
+void Model::markChanged(int frameIndex)
+{
+    savedChunks[frameIndex] = -1;
+    revision++;
+}
 
-    QJsonDocument projectDoc(QJsonDocument::fromJson(saveData));
-    QJsonObject projectObject = projectDoc.object();
+void Model::setupAutosave()
+{
+    connect(&autosaveTimer, &QTimer::timeout, this, &Model::autosave);
+    connect(&autosaveWatcher, &QFutureWatcher<bool>::finished, this, [this](){
+        emit autosaved(autosaveTarget, autosaveWatcher.result());
+    });
+    setAutosaveInterval(defaultAutosaveMinutes);
+}
 
-    if(projectObject.contains("height"))
+void Model::autosave()
+{
+    if(loading || revision == autosavedRevision || autosaveWatcher.isRunning())
     {
-        frameSize = projectObject["height"].toInt();
+        return;
     }
+    autosavedRevision = revision;
+    autosaveTarget = autosavePath();
+
+    // Copying the frames only copies references to their images; an image that is painted
+    // while the worker is still writing detaches, so the snapshot never changes underneath it
+    std::vector<Frame> snapshot = frames;
+    QString filepath = autosaveTarget;
+    int size = frameSize;
+    autosaveWatcher.setFuture(QtConcurrent::run([snapshot, filepath, size](){
+        return writeAutosave(filepath, snapshot, size);
+    }));
+}
 
-    if(projectObject.contains("frames"))
+QString Model::autosavePath()
+{
+    if(!projectPath.isEmpty())
     {
-        QJsonObject framesArray = projectObject["frames"].toObject();
-        frames.clear();
-        currentFrameIndex = 0;
+        return projectPath + ".autosave";
+    }
+    QString name = QString("LeSporkEditor-%1-%2.ssp.autosave")
+            .arg(QCoreApplication::applicationPid())
+            .arg(QString::number((quintptr)this, 16));
+    return QDir::temp().filePath(name);
+}
 
-        for(int frameIndex = 0; frameIndex < framesArray.size(); frameIndex++)
-        {
-            Frame f(frameSize, frameSize);
-            frames.push_back(f);
-            QString s = QString::number(frameIndex);
-            QJsonArray rowsArray = framesArray["frame" + s].toArray();
+int Model::getAutosaveInterval()
+{
+    return autosaveTimer.isActive() ? autosaveTimer.interval() / 60000 : 0;
+}
 
-            for(int rowIndex = 0; rowIndex < rowsArray.size(); rowIndex++)
-            {
-                QJsonArray pixelsArray = rowsArray[rowIndex].toArray();
-                for(int pixelIndex = 0; pixelIndex < pixelsArray.size(); pixelIndex++)
-                {
-                    QJsonArray pixelColors = pixelsArray[pixelIndex].toArray();
-                    QColor pixelColor(pixelColors[0].toInt(),pixelColors[1].toInt(),
-                            pixelColors[2].toInt(), pixelColors[3].toInt());
-                    frames[frameIndex].setPixel(pixelIndex, rowIndex, pixelColor);
-                }
-            }
+int Model::getExportScale()
+{
+    return exportScale;
+}
+
+void Model::setExportScale(int scale)
+{
+    exportScale = qBound(1, scale, PixelScaler::maxFactor);
+}
+
+void Model::setAutosaveInterval(int minutes)
+{
+    if(minutes <= 0)
+    {
+        autosaveTimer.stop();
+        return;
+    }
+    autosaveTimer.start(minutes * 60000);
+}
+
+void Model::startLoading(QString filepath)
+{
+    loading = true;
+    loadCancelled = false;
+    loadingPath = filepath;
+    loadingProject = std::make_shared<LoadedProject>();
+
+    // The callbacks run on the worker thread, so everything they tell the View is queued back
+    // to this thread; anything still queued when the Model is destroyed is dropped
+    qint64 totalBytes = QFileInfo(filepath).size();
+    ReadProgress progress;
+    progress.update = [this, totalBytes](qint64 bytesRead, int framesDecoded){
+        QMetaObject::invokeMethod(this, [this, bytesRead, totalBytes, framesDecoded](){
+            emit loadProgress(bytesRead, totalBytes, framesDecoded);
+        }, Qt::QueuedConnection);
+        return !loadCancelled;
+    };
+    progress.firstFrame = [this](const QImage& frame){
+        QMetaObject::invokeMethod(this, [this, frame](){showFirstFrame(frame);}, Qt::QueuedConnection);
+    };
+
+    std::shared_ptr<LoadedProject> project = loadingProject;
+    loadWatcher.setFuture(QtConcurrent::run([filepath, project, progress](){
+        return readProject(filepath, *project, progress);
+    }));
+}
+
+void Model::showFirstFrame(QImage frame)
+{
+    if(!loading || currentFrameIndex != 0)
+    {
+        return;
+    }
+    if(frame.height() != frameSize)
+    {
+        frameSize = frame.height();
+        emit frameSizeChanged(frameSize);
+    }
+    frames[0] = Frame(frame);
+    emit updateCanvas(frames[0].getPixMap());
+}
+
+void Model::finishLoading()
+{
+    bool loaded = loadWatcher.result() && !loadingProject->frames.empty();
+    if(loaded)
+    {
+        int oldSize = frameSize;
+        frames = std::move(loadingProject->frames);
+        frameSize = loadingProject->height;
+        currentFrameIndex = 0;
+        previewFrameIndex = 0;
+        markSaved(loadingProject->binary ? loadingPath : QString());
+        projectPath = loadingPath;
+        if(frameSize != oldSize)
+        {
+            emit frameSizeChanged(frameSize);
         }
+        emit updateCanvas(frames[currentFrameIndex].getPixMap());
+        emit updateNumberOfFrames(QString::number(frames.size()));
+        emit updateCurrentFrameIndex(QString::number(currentFrameIndex + 1));
     }
+    else if(!loadCancelled)
+    {
+        qWarning("Couldn't read save file.");
+    }
+    loadingProject.reset();
+    loading = false;
+    emit loadFinished(loaded);
+}
+
+void Model::cancelLoading()
+{
+    loadCancelled = true;
+}
+
+bool Model::isLoading()
+{
+    return loading;
 }
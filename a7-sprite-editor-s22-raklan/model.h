@@ -9,9 +9,20 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QFile>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <atomic>
+#include <memory>
 #include "frame.h"
+#include "projectfile.h"
+#include "jsonproject.h"
+#include "spritesheet.h"
+#include "engineexport.h"
+#include "videostream.h"
 #include "commonDataTypes.h"
 
+struct LoadedProject;
+
 class Model : public QObject
 {
 private:
@@ -28,6 +39,29 @@ private:
     bool playPreview = true;
     int previewFrameIndex = 0;
     bool previewScaling = true;
+    // The binary project the frames were last opened from or saved to, and for each frame the
+    // chunk in that file holding its pixels, or -1 once the frame has changed since
+    QString journalPath;
+    std::vector<int> savedChunks;
+    // The file the project was opened from or last saved to, empty for a new Sprite
+    QString projectPath;
+    // Counts edits, so autosave can tell whether anything changed since it last ran
+    int revision = 0;
+    int autosavedRevision = 0;
+    QTimer autosaveTimer;
+    QFutureWatcher<bool> autosaveWatcher;
+    QString autosaveTarget;
+    QFutureWatcher<bool> exportWatcher;
+    QString exportTarget;
+    // How many times larger frames and sprite sheets are exported as images
+    int exportScale = 1;
+    // The project being read on a worker thread; until it finishes the frames hold a blank
+    // placeholder, or the first frame once it has been decoded
+    QFutureWatcher<bool> loadWatcher;
+    std::shared_ptr<LoadedProject> loadingProject;
+    QString loadingPath;
+    std::atomic<bool> loadCancelled{false};
+    bool loading = false;
 
     /**
      * @brief Controller for the preview itself. It will handle updating the Preview at the
@@ -64,15 +98,56 @@ private:
      */
     int getPreviewWindowScalar();
     /**
-     * @brief Writes the current Sprite to the given filepath as a JSON object, saved in a
-     * .ssp file
+     * @brief Writes the current Sprite to the given filepath as a .ssp file in the given format
+     */
+    void write(QString filepath, ProjectFormat format);
+    /**
+     * @brief Saves over the binary project at journalPath by appending only the frames that
+     * changed since it was opened or last saved
+     * @return a true/false on whether the project was saved; false if it needs a full rewrite
+     */
+    bool appendChangedFrames(const ProjectFile::WriteOptions& options);
+    /**
+     * @brief Records that every frame now matches its chunk in the project at filepath
+     * @param filepath the binary project just opened or saved, or an empty string if the
+     * frames are no longer backed by one
+     */
+    void markSaved(QString filepath);
+    /**
+     * @brief Records that a frame has changed since the project was last saved
+     * @param frameIndex the index of the frame that changed
+     */
+    void markChanged(int frameIndex);
+    /**
+     * @brief Starts the autosave timer at the default interval
+     */
+    void setupAutosave();
+    /**
+     * @brief Snapshots the frames and writes them to the autosave file on a worker thread,
+     * if anything changed since the last autosave and none is still running
+     */
+    void autosave();
+    /**
+     * @brief Returns where autosaves of this project are written: next to the project file,
+     * or in the temporary directory for a Sprite that has never been saved
      */
-    void write(QString filepath) const;
+    QString autosavePath();
     /**
-     * @brief Reads a previously saved .ssp file, populating each frame as dictated by the
-     * savefile
+     * @brief Starts reading a previously saved .ssp file on a worker thread. Binary projects
+     * are detected by their magic bytes, anything else is read as JSON in whichever encoding
+     * it was saved with
      */
-    void read(QString filepath);
+    void startLoading(QString filepath);
+    /**
+     * @brief Shows the first frame of the project being loaded in place of the placeholder
+     * @param frame the decoded first frame
+     */
+    void showFirstFrame(QImage frame);
+    /**
+     * @brief Takes the frames read by the worker thread, or keeps the placeholder if the
+     * read failed or was cancelled
+     */
+    void finishLoading();
 
     /**
      * @brief Given a starting position, color to paint with, and color to paint over, this will
@@ -117,6 +192,11 @@ public:
      * @param parent A parent QObject
      */
     Model(QString filepath);
+    /**
+     * @brief Cancels any load still running and waits for it and any autosave or export to
+     * finish
+     */
+    ~Model();
     /**
      * @brief Returns the color saved to the Left Mouse Button. Used by the View to keep
      * the color selector buttons current
@@ -134,18 +214,71 @@ public:
      * @return the frame size of the current Sprite
      */
     int getSize();    
+    /**
+     * @brief Returns how often the project is autosaved
+     * @return the autosave interval in minutes, 0 if autosave is off
+     */
+    int getAutosaveInterval();
+    /**
+     * @brief Returns how many times larger frames and sprite sheets are exported as images
+     * @return the export scale, 1 for their own size
+     */
+    int getExportScale();
+    /**
+     * @brief Returns whether the project is still being read from its file
+     * @return true until the load has finished, failed, or been cancelled
+     */
+    bool isLoading();
 
 public slots:
     /**
      * @brief Driver for write(), gives the View a public slot to bind to.
      */
-    void saveProject(QString filepath);
+    void saveProject(QString filepath, ProjectFormat format);
     /**
      * @brief Exports the current frame as a .png file, saved at the given
-     * filepath
+     * filepath; a .h or .txt filepath exports it as a C/C++ header or as text instead
      * @param the filepath at which the .png file should be saved
      */
     void exportFame(QString filePath);
+    /**
+     * @brief Exports every frame packed into one image, with a .json file of where each
+     * frame is and how long it is shown written next to it. Returns straight away;
+     * framesExported reports when both are written
+     * @param filePath the filepath at which the sheet image should be saved
+     * @param options how the sheet is laid out; the frame duration is taken from the preview FPS
+     */
+    void exportSpriteSheet(QString filePath, SpriteSheet::Options options);
+    /**
+     * @brief Exports every frame as its own numbered .png file on the global thread pool,
+     * e.g. walk.png becomes walk_001.png, walk_002.png, and so on. Returns straight away;
+     * framesExported reports when the files are written
+     * @param filePath the filepath the numbered filepaths are made from
+     * @param compressionLevel the zlib level from 0, fastest, to 9, smallest
+     */
+    void exportAllFrames(QString filePath, int compressionLevel);
+    /**
+     * @brief Exports every frame as a looping animation, each shown for as long as the preview
+     * FPS gives: an animated PNG if the filepath ends in .png, a GIF otherwise. Returns straight
+     * away; framesExported reports when it is written
+     * @param filePath the filepath at which the animation should be saved
+     */
+    void exportAnimation(QString filePath);
+    /**
+     * @brief Exports frames as an uncompressed blob a game engine can map straight into
+     * memory. Returns straight away; framesExported reports when it is written
+     * @param filePath the filepath at which the blob should be saved
+     * @param format how each pixel is stored
+     * @param allFrames whether to export every frame or only the current one
+     */
+    void exportEngineData(QString filePath, EngineExport::PixelFormat format, bool allFrames);
+    /**
+     * @brief Exports the animation as an uncompressed video stream at the preview FPS and the
+     * export scale: raw RGBA if the filepath ends in .rgba or .raw, YUV4MPEG2 otherwise.
+     * Returns straight away; framesExported reports when it is written
+     * @param filePath the filepath at which the stream should be saved
+     */
+    void exportVideo(QString filePath);
     /**
      * @brief Informs the Model that the mouse has been clicked and/or dragged on the
      * canvas. Uses the given QMouseEvent to determine where and how to paint
@@ -179,6 +312,21 @@ public slots:
      * @param value the new value of the slider
      */
     void previewFPSChanged(int value);
+    /**
+     * @brief Changes how often the project is autosaved
+     * @param minutes the new interval in minutes, 0 turns autosave off
+     */
+    void setAutosaveInterval(int minutes);
+    /**
+     * @brief Changes how many times larger PNG frames, numbered frames and sprite sheets are
+     * exported, each pixel becoming a square block
+     * @param scale the factor from 1 to 16
+     */
+    void setExportScale(int scale);
+    /**
+     * @brief Stops reading the project; the Sprite is left with the frames it had before
+     */
+    void cancelLoading();
 
 signals:
     /**
@@ -206,6 +354,36 @@ signals:
      * @param frameSize
      */
     void updateNumberOfFrames(QString frameSize);
+    /**
+     * @brief Reports that an autosave has finished
+     * @param filepath the file the autosave was written to
+     * @param saved a true/false on whether the autosave succeeded
+     */
+    void autosaved(QString filepath, bool saved);
+    /**
+     * @brief Reports that a background export has finished
+     * @param filePath the exported file, or the filepath the numbered filepaths were made from
+     * @param exported a true/false on whether every frame was written
+     */
+    void framesExported(QString filePath, bool exported);
+    /**
+     * @brief Reports how far the project being opened has been read
+     * @param bytesRead how much of the file has been read
+     * @param totalBytes the size of the file
+     * @param framesDecoded how many frames have been decoded so far
+     */
+    void loadProgress(qint64 bytesRead, qint64 totalBytes, int framesDecoded);
+    /**
+     * @brief Reports that the project being opened has finished loading
+     * @param loaded a true/false on whether the project was read; false if it failed or was
+     * cancelled
+     */
+    void loadFinished(bool loaded);
+    /**
+     * @brief Reports that the size of the Sprite changed, so the View can rescale its canvas
+     * @param frameSize the new size in pixels of each side of the Sprite
+     */
+    void frameSizeChanged(int frameSize);
 
 };
 
@@ -0,0 +1,54 @@
+#ifndef PARALLELENCODE_H
+#define PARALLELENCODE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief encodeFramesInOrder serializes frames concurrently and writes them to the device in
+ * frame order. Frames are encoded on the global thread pool a batch at a time into one buffer
+ * per batch slot, then the batch is written out before the next one starts, so memory stays
+ * bounded by the batch size no matter how many frames the Sprite has.
+ * @param device an open, writable device
+ * @param frameCount the number of frames to encode
+ * @param encode called as encode(frameIndex, buffer) on a worker thread; appends the frame's
+ * bytes to the empty buffer
+ * @param written called as written(frameIndex, buffer) on the calling thread just before the
+ * buffer is written, e.g. to record where the frame lands in the file
+ * @return a true/false on whether every byte could be written
+ */
+template<typename Encode, typename Written>
+bool encodeFramesInOrder(QIODevice& device, int frameCount, Encode encode, Written written)
+{
+    const int batchSize = std::max(1, QThreadPool::globalInstance()->maxThreadCount() * 2);
+    std::vector<QByteArray> buffers(std::min(batchSize, frameCount));
+    std::vector<int> batch;
+    for(int first = 0; first < frameCount; first += batchSize)
+    {
+        const int count = std::min(batchSize, frameCount - first);
+        batch.resize(count);
+        for(int slot = 0; slot < count; slot++)
+        {
+            batch[slot] = slot;
+        }
+        QtConcurrent::blockingMap(batch, [&](int slot){
+            buffers[slot].resize(0);
+            encode(first + slot, buffers[slot]);
+        });
+        for(int slot = 0; slot < count; slot++)
+        {
+            written(first + slot, buffers[slot]);
+            if(device.write(buffers[slot]) != buffers[slot].size())
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+#endif // PARALLELENCODE_H
@@ -0,0 +1,70 @@
+#include "pixelscaler.h"
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Defined here as well, since qBound takes it by reference
+const int PixelScaler::maxFactor;
+
+void PixelScaler::widenRow(const QRgb* pixels, int width, int factor, QRgb* out)
+{
+    int x = 0;
+#if defined(__SSE2__)
+    if(factor == 2)
+    {
+        // Interleaving four pixels with themselves doubles them into two registers
+        for(; x + 4 <= width; x += 4)
+        {
+            const __m128i p = _mm_loadu_si128((const __m128i*)(pixels + x));
+            _mm_storeu_si128((__m128i*)(out + x * 2), _mm_unpacklo_epi32(p, p));
+            _mm_storeu_si128((__m128i*)(out + x * 2 + 4), _mm_unpackhi_epi32(p, p));
+        }
+    }
+    else if(factor >= 3)
+    {
+        // Each pixel fills its block a register at a time. A block that isn't a multiple of
+        // four pixels spills into the next one, which overwrites it, so the last pixel of the
+        // row is left to the plain loop
+        for(; x + 1 < width; x++)
+        {
+            const __m128i p = _mm_set1_epi32((int)pixels[x]);
+            QRgb* block = out + x * factor;
+            for(int i = 0; i < factor; i += 4)
+            {
+                _mm_storeu_si128((__m128i*)(block + i), p);
+            }
+        }
+    }
+#endif
+    for(; x < width; x++)
+    {
+        QRgb* block = out + x * factor;
+        for(int i = 0; i < factor; i++)
+        {
+            block[i] = pixels[x];
+        }
+    }
+}
+
+QImage PixelScaler::scale(const QImage& image, int factor)
+{
+    factor = qBound(1, factor, maxFactor);
+    if(factor == 1 || image.isNull())
+    {
+        return image;
+    }
+    const QImage source = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+    QImage scaled(source.width() * factor, source.height() * factor, QImage::Format_ARGB32);
+    const size_t rowBytes = (size_t)scaled.width() * sizeof(QRgb);
+    for(int y = 0; y < source.height(); y++)
+    {
+        uchar* first = scaled.scanLine(y * factor);
+        widenRow((const QRgb*)source.constScanLine(y), source.width(), factor, (QRgb*)first);
+        for(int copy = 1; copy < factor; copy++)
+        {
+            memcpy(scaled.scanLine(y * factor + copy), first, rowBytes);
+        }
+    }
+    return scaled;
+}
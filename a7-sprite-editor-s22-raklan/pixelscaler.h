@@ -0,0 +1,35 @@
+#ifndef PIXELSCALER_H
+#define PIXELSCALER_H
+
+#include <QImage>
+
+/**
+ * @brief PixelScaler enlarges pixel art by a whole number, turning every pixel into a square
+ * block of the same color so edges stay hard. Each source row is widened once, repeating every
+ * pixel across the block, several pixels at a time where the CPU has vector instructions; the
+ * widened row is then copied down the rest of the block's rows.
+ */
+class PixelScaler
+{
+public:
+    static const int maxFactor = 16;
+
+    /**
+     * @brief scale enlarges an image
+     * @param image the image to enlarge
+     * @param factor how many times wider and taller to make it, from 1 to maxFactor
+     * @return the enlarged ARGB32 image; the image itself if the factor is 1
+     */
+    static QImage scale(const QImage& image, int factor);
+
+    /**
+     * @brief widenRow repeats every pixel of a row factor times
+     * @param pixels the row to widen
+     * @param width the number of pixels in the row
+     * @param factor how many times to repeat each pixel
+     * @param out receives width * factor pixels
+     */
+    static void widenRow(const QRgb* pixels, int width, int factor, QRgb* out);
+};
+
+#endif // PIXELSCALER_H
@@ -0,0 +1,1239 @@
+#include "projectfile.h"
+#include "parallelencode.h"
+#include "crc32.h"
+#include <QtEndian>
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QFileDevice>
+#include <QBuffer>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+static const char projectMagic[4] = {'S', 'S', 'P', 'B'};
+
+// Largest side we accept from a file, guards against allocating garbage sizes
+static const int maxFrameSide = 16384;
+
+// Size of the rectangle that starts every delta payload
+static const int deltaHeaderSize = 16;
+
+// Size of a reference chunk: the index of the earlier frame it repeats
+static const int referenceSize = 4;
+
+// Most colors an indexed chunk can refer to
+static const int maxPaletteSize = 256;
+
+// Largest thumbnail we accept from a file; a 64 x 64 PNG is far smaller than this
+static const quint32 maxThumbnailSize = 1024 * 1024;
+
+// Position of the checksum in the header, zeroed while the checksum is computed
+static const int checksumOffset = 44;
+
+/**
+ * @brief Palette is the project-wide color table that indexed chunks refer to. Palettes of
+ * up to 16 colors pack two pixels into each byte, larger ones use a byte per pixel.
+ */
+struct Palette
+{
+    quint64 offset = 0;
+    std::vector<QRgb> colors;
+    // Index of each color, only filled in while writing
+    QHash<QRgb, int> indices;
+
+    int bits() const
+    {
+        return colors.size() <= 16 ? 4 : 8;
+    }
+
+    int rowBytes(int width) const
+    {
+        return bits() == 4 ? (width + 1) / 2 : width;
+    }
+
+    void buildIndices()
+    {
+        indices.clear();
+        for(int i = 0; i < (int)colors.size(); i++)
+        {
+            indices.insert(colors[i], i);
+        }
+    }
+};
+
+/**
+ * @brief packIndices writes the palette index of every pixel of a rectangle of the image,
+ * rows packed to whole bytes
+ * @return false if a pixel's color isn't in the palette
+ */
+static bool packIndices(const QImage& image, const QRect& rect, const Palette& palette, uchar* out)
+{
+    const int rowBytes = palette.rowBytes(rect.width());
+    const bool nibbles = palette.bits() == 4;
+    // Pixel art repeats colors in runs, so the last lookup is remembered
+    QRgb lastColor = 0;
+    int lastIndex = -1;
+    for(int y = rect.top(); y <= rect.bottom(); y++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(y) + rect.left();
+        memset(out, 0, rowBytes);
+        for(int x = 0; x < rect.width(); x++)
+        {
+            if(lastIndex < 0 || row[x] != lastColor)
+            {
+                QHash<QRgb, int>::const_iterator found = palette.indices.constFind(row[x]);
+                if(found == palette.indices.constEnd())
+                {
+                    return false;
+                }
+                lastColor = row[x];
+                lastIndex = found.value();
+            }
+            if(nibbles)
+            {
+                out[x / 2] |= lastIndex << ((x & 1) ? 0 : 4);
+            }
+            else
+            {
+                out[x] = lastIndex;
+            }
+        }
+        out += rowBytes;
+    }
+    return true;
+}
+
+/**
+ * @brief unpackIndices expands packed palette indices into a rectangle of the image through
+ * the palette's color table
+ * @return false if an index is outside the palette
+ */
+static bool unpackIndices(const uchar* in, const QRect& rect, const Palette& palette, QImage& image)
+{
+    const int rowBytes = palette.rowBytes(rect.width());
+    const bool nibbles = palette.bits() == 4;
+    const QRgb* lut = palette.colors.data();
+    const uint colorCount = palette.colors.size();
+    for(int y = rect.top(); y <= rect.bottom(); y++)
+    {
+        QRgb* row = (QRgb*)image.scanLine(y) + rect.left();
+        for(int x = 0; x < rect.width(); x++)
+        {
+            uint index = nibbles ? (in[x / 2] >> ((x & 1) ? 0 : 4)) & 0xf : in[x];
+            if(index >= colorCount)
+            {
+                return false;
+            }
+            row[x] = lut[index];
+        }
+        in += rowBytes;
+    }
+    return true;
+}
+
+/**
+ * @brief findPalette collects the distinct colors of every frame, each frame on the global
+ * thread pool
+ * @return false if the frames use more colors than an indexed chunk can refer to
+ */
+static bool findPalette(const std::vector<Frame>& frames, Palette& palette)
+{
+    struct FrameColors
+    {
+        QImage image;
+        QSet<QRgb> colors;
+        bool overflow;
+    };
+    std::vector<FrameColors> perFrame(frames.size());
+    for(size_t i = 0; i < frames.size(); i++)
+    {
+        perFrame[i].image = frames[i].getImage();
+        perFrame[i].overflow = false;
+    }
+    QtConcurrent::blockingMap(perFrame, [](FrameColors& frame){
+        QRgb lastColor = 0;
+        bool first = true;
+        for(int y = 0; y < frame.image.height() && !frame.overflow; y++)
+        {
+            const QRgb* row = (const QRgb*)frame.image.constScanLine(y);
+            for(int x = 0; x < frame.image.width(); x++)
+            {
+                if(first || row[x] != lastColor)
+                {
+                    frame.colors.insert(row[x]);
+                    lastColor = row[x];
+                    first = false;
+                }
+            }
+            frame.overflow = frame.colors.size() > maxPaletteSize;
+        }
+        frame.image = QImage();
+    });
+
+    QSet<QRgb> colors;
+    for(const FrameColors& frame : perFrame)
+    {
+        if(frame.overflow)
+        {
+            return false;
+        }
+        colors.unite(frame.colors);
+        if(colors.size() > maxPaletteSize)
+        {
+            return false;
+        }
+    }
+
+    // Sorted so the same colors always get the same indices
+    palette.colors.assign(colors.begin(), colors.end());
+    std::sort(palette.colors.begin(), palette.colors.end());
+    palette.buildIndices();
+    return !palette.colors.empty();
+}
+
+/**
+ * @brief ChunkJob is one frame chunk on its way from the file to a decoded image
+ */
+struct ChunkJob
+{
+    quint64 offset = 0;
+    quint32 size = 0;
+    quint16 encoding = 0;
+    QByteArray bytes;
+    const uchar* data = nullptr;
+    QImage image;
+    QByteArray delta;
+    // The earlier frame a reference chunk repeats, -1 for any other chunk
+    qint64 reference = -1;
+    bool decoded = false;
+};
+
+/**
+ * @brief decodeChunk inflates a chunk and, for full frames, decodes its pixels. Delta chunks
+ * keep their payload in job.delta until the previous frame is available, reference chunks
+ * only set job.reference.
+ */
+static bool decodeChunk(ChunkJob& job, int width, int height, const Palette& palette)
+{
+    if((job.encoding & 0xff) == ProjectFile::ReferenceChunk)
+    {
+        if(job.size != referenceSize)
+        {
+            return false;
+        }
+        job.reference = qFromLittleEndian<quint32>(job.data);
+        return true;
+    }
+    const bool indexed = job.encoding & ProjectFile::IndexedChunk;
+    if(indexed && palette.colors.empty())
+    {
+        return false;
+    }
+    const quint32 rawSize = width * height * 4;
+    const quint32 pixelSize = indexed ? palette.rowBytes(width) * height : rawSize;
+    const uchar* payload = job.data;
+    qint64 payloadSize = job.size;
+    QByteArray inflated;
+    switch(job.encoding & 0xff)
+    {
+    case ProjectFile::RawChunk:
+        break;
+    case ProjectFile::ZlibChunk:
+    {
+        // qCompress prefixes the uncompressed size; check it before inflating anything
+        if(job.size < 4 || qFromBigEndian<quint32>(job.data) > rawSize + deltaHeaderSize)
+        {
+            return false;
+        }
+        inflated = qUncompress(job.data, job.size);
+        payload = (const uchar*)inflated.constData();
+        payloadSize = inflated.size();
+        break;
+    }
+    default:
+        return false;
+    }
+
+    if(job.encoding & ProjectFile::DeltaChunk)
+    {
+        job.delta = inflated.isEmpty() ? QByteArray((const char*)payload, payloadSize) : inflated;
+        return payloadSize >= deltaHeaderSize;
+    }
+    if(payloadSize != pixelSize)
+    {
+        return false;
+    }
+    if(indexed)
+    {
+        // Every pixel is written by the lookup, so the image isn't cleared first
+        QImage image(width, height, QImage::Format_ARGB32);
+        if(!unpackIndices(payload, image.rect(), palette, image))
+        {
+            return false;
+        }
+        job.image = image;
+        return true;
+    }
+    Frame frame(width, height);
+    frame.readRaw(payload);
+    job.image = frame.getImage();
+    return true;
+}
+
+static void encodeDeltaRect(const QRect& changed, uchar* out)
+{
+    qToLittleEndian<quint32>(changed.x(), out);
+    qToLittleEndian<quint32>(changed.y(), out + 4);
+    qToLittleEndian<quint32>(changed.width(), out + 8);
+    qToLittleEndian<quint32>(changed.height(), out + 12);
+}
+
+/**
+ * @brief encodeDelta writes the delta payload that turns previous into frame. With a palette
+ * the changed rectangle is stored as the palette indices of the new pixels, otherwise as its
+ * pixels XORed with the previous frame's
+ * @return true if the rectangle was stored as palette indices
+ */
+static bool encodeDelta(const Frame& previous, const Frame& frame, const Palette* palette, QByteArray& payload)
+{
+    QRect changed = frame.changedRect(previous);
+    QImage before = previous.getImage();
+    QImage after = frame.getImage();
+
+    if(palette != nullptr)
+    {
+        payload.resize(deltaHeaderSize + palette->rowBytes(changed.width()) * changed.height());
+        uchar* out = (uchar*)payload.data();
+        if(changed.isEmpty() || packIndices(after, changed, *palette, out + deltaHeaderSize))
+        {
+            encodeDeltaRect(changed, out);
+            return true;
+        }
+    }
+
+    payload.resize(deltaHeaderSize + changed.width() * changed.height() * 4);
+    uchar* out = (uchar*)payload.data();
+    encodeDeltaRect(changed, out);
+    out += deltaHeaderSize;
+    for(int y = changed.top(); y <= changed.bottom(); y++)
+    {
+        const QRgb* beforeRow = (const QRgb*)before.constScanLine(y);
+        const QRgb* afterRow = (const QRgb*)after.constScanLine(y);
+        for(int x = changed.left(); x <= changed.right(); x++)
+        {
+            qToLittleEndian<quint32>(beforeRow[x] ^ afterRow[x], out);
+            out += 4;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief applyDelta rebuilds a frame from the previous frame and a delta payload
+ * @return false if the payload doesn't fit the frame
+ */
+static bool applyDelta(const QImage& previous, const QByteArray& payload, bool indexed,
+                       const Palette& palette, QImage& image)
+{
+    const uchar* in = (const uchar*)payload.constData();
+    quint32 x = qFromLittleEndian<quint32>(in);
+    quint32 y = qFromLittleEndian<quint32>(in + 4);
+    quint32 width = qFromLittleEndian<quint32>(in + 8);
+    quint32 height = qFromLittleEndian<quint32>(in + 12);
+    // Compared without adding, so values from a corrupt file can't wrap past the check
+    const quint32 frameWidth = (quint32)previous.width();
+    const quint32 frameHeight = (quint32)previous.height();
+    if(x > frameWidth || width > frameWidth - x || y > frameHeight || height > frameHeight - y)
+    {
+        return false;
+    }
+    const quint64 pixelSize = indexed ? (quint64)palette.rowBytes(width) * height : (quint64)width * height * 4;
+    if((quint64)payload.size() != deltaHeaderSize + pixelSize)
+    {
+        return false;
+    }
+    in += deltaHeaderSize;
+
+    if(width == 0 || height == 0)
+    {
+        // Held frame: share the previous frame's pixels
+        image = previous;
+        return true;
+    }
+    image = previous.copy();
+    if(indexed)
+    {
+        return unpackIndices(in, QRect(x, y, width, height), palette, image);
+    }
+    for(quint32 row = y; row < y + height; row++)
+    {
+        QRgb* pixels = (QRgb*)image.scanLine(row);
+        for(quint32 column = x; column < x + width; column++)
+        {
+            pixels[column] ^= qFromLittleEndian<quint32>(in);
+            in += 4;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief headerChecksum computes the checksum stored in a header, over the header with its
+ * checksum field zeroed and then the thumbnail
+ */
+static quint32 headerChecksum(const QByteArray& header, const QByteArray& thumbnail)
+{
+    QByteArray zeroed = header;
+    memset(zeroed.data() + checksumOffset, 0, 4);
+    quint32 crc = crc32((const uchar*)zeroed.constData(), zeroed.size());
+    return crc32((const uchar*)thumbnail.constData(), thumbnail.size(), crc);
+}
+
+/**
+ * @brief Thumbnail is the PNG of frame 0 stored near the start of a binary project
+ */
+struct Thumbnail
+{
+    quint64 offset = 0;
+    QByteArray png;
+};
+
+/**
+ * @brief encodeThumbnail scales the first frame down to fit thumbnailSide, keeping hard pixel
+ * edges, and encodes it as a PNG
+ * @return the PNG, or nothing if there are no frames
+ */
+static QByteArray encodeThumbnail(const std::vector<Frame>& frames)
+{
+    if(frames.empty())
+    {
+        return QByteArray();
+    }
+    QImage image = frames[0].getImage();
+    if(image.width() > ProjectFile::thumbnailSide || image.height() > ProjectFile::thumbnailSide)
+    {
+        image = image.scaled(ProjectFile::thumbnailSide, ProjectFile::thumbnailSide,
+                             Qt::KeepAspectRatio, Qt::FastTransformation);
+    }
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return png;
+}
+
+/**
+ * @brief readThumbnail loads the thumbnail a header points at and checks the header's checksum
+ * @param header the header as read from the start of the device
+ * @return false if the thumbnail is out of bounds or the checksum doesn't match
+ */
+static bool readThumbnail(QIODevice& device, const QByteArray& header, Thumbnail& thumbnail)
+{
+    const uchar* h = (const uchar*)header.constData();
+    // Files from before version 3 leave every field from the checksum on zeroed
+    if(qFromLittleEndian<quint16>(h + 4) < 3)
+    {
+        thumbnail = Thumbnail();
+        return true;
+    }
+    thumbnail.offset = qFromLittleEndian<quint64>(h + 48);
+    quint32 size = qFromLittleEndian<quint32>(h + 56);
+    const quint64 fileSize = device.size();
+    if(size > maxThumbnailSize || thumbnail.offset > fileSize || size > fileSize - thumbnail.offset
+            || !device.seek(thumbnail.offset))
+    {
+        qWarning("Binary project has an invalid thumbnail.");
+        return false;
+    }
+    thumbnail.png = device.read(size);
+    if(thumbnail.png.size() != (int)size || headerChecksum(header, thumbnail.png) != qFromLittleEndian<quint32>(h + checksumOffset))
+    {
+        qWarning("Binary project header is corrupt.");
+        return false;
+    }
+    return true;
+}
+
+bool ProjectFile::isBinaryProject(const QByteArray& leadingBytes)
+{
+    return leadingBytes.size() >= 4 && memcmp(leadingBytes.constData(), projectMagic, 4) == 0;
+}
+
+static QByteArray encodeHeader(quint32 width, quint32 height, quint32 frameCount, quint64 indexOffset,
+                               const Palette& palette, const Thumbnail& thumbnail)
+{
+    QByteArray header(ProjectFile::headerSize, '\0');
+    uchar* h = (uchar*)header.data();
+    memcpy(h, projectMagic, 4);
+    qToLittleEndian<quint16>(ProjectFile::currentVersion, h + 4);
+    qToLittleEndian<quint16>(ProjectFile::headerSize, h + 6);
+    qToLittleEndian<quint32>(width, h + 8);
+    qToLittleEndian<quint32>(height, h + 12);
+    qToLittleEndian<quint32>(frameCount, h + 16);
+    qToLittleEndian<quint64>(indexOffset, h + 24);
+    qToLittleEndian<quint64>(palette.offset, h + 32);
+    qToLittleEndian<quint16>(palette.colors.size(), h + 40);
+    qToLittleEndian<quint64>(thumbnail.offset, h + 48);
+    qToLittleEndian<quint32>(thumbnail.png.size(), h + 56);
+    qToLittleEndian<quint32>(headerChecksum(header, thumbnail.png), h + checksumOffset);
+    return header;
+}
+
+static QByteArray encodePalette(const Palette& palette)
+{
+    QByteArray table(palette.colors.size() * 4, '\0');
+    qToLittleEndian<quint32>(palette.colors.data(), palette.colors.size(), table.data());
+    return table;
+}
+
+// zlib level used for compressed chunks
+static const int compressionLevel = 6;
+
+static bool isDeltaFrame(int frameIndex, const ProjectFile::WriteOptions& options)
+{
+    return options.keyframeInterval > 0 && frameIndex % options.keyframeInterval != 0;
+}
+
+/**
+ * @brief findDuplicates points each frame that repeats the pixels of an earlier frame at the
+ * first frame with those pixels. Frames are hashed on the global thread pool, then sorted by
+ * hash so only frames whose hashes match are compared byte for byte
+ * @param frames the frames of the Sprite; the candidates must already be loaded
+ * @param candidates the indices of the frames to look for duplicates among
+ * @param references resized to the number of frames; -1 for a frame that repeats no earlier
+ * candidate, otherwise the index of the frame it repeats
+ */
+static void findDuplicates(const std::vector<Frame>& frames, const std::vector<int>& candidates,
+                           std::vector<int>& references)
+{
+    references.assign(frames.size(), -1);
+    std::vector<std::pair<size_t, int>> hashes(candidates.size());
+    for(size_t i = 0; i < candidates.size(); i++)
+    {
+        hashes[i].second = candidates[i];
+    }
+    QtConcurrent::blockingMap(hashes, [&frames](std::pair<size_t, int>& hash){
+        hash.first = frames[hash.second].contentHash();
+    });
+
+    // Sorting by hash, then index, puts the first copy of a frame ahead of its repeats
+    std::sort(hashes.begin(), hashes.end());
+    size_t run = 0;
+    while(run < hashes.size())
+    {
+        size_t end = run + 1;
+        while(end < hashes.size() && hashes[end].first == hashes[run].first)
+        {
+            end++;
+        }
+        for(size_t i = run + 1; i < end; i++)
+        {
+            const int frameIndex = hashes[i].second;
+            for(size_t j = run; j < i; j++)
+            {
+                const int original = hashes[j].second;
+                if(references[original] < 0 && frames[frameIndex].samePixels(frames[original]))
+                {
+                    references[frameIndex] = original;
+                    break;
+                }
+            }
+        }
+        run = end;
+    }
+}
+
+/**
+ * @brief encodeFrame writes the chunk payload of one frame, as a reference to an earlier copy,
+ * as a delta against the frame before it or as the full frame, and as palette indices when
+ * every color is in the palette
+ * @param reference the earlier frame with the same pixels, or -1 if there is none
+ * @return the encoding of the chunk
+ */
+static quint16 encodeFrame(const std::vector<Frame>& frames, int frameIndex, int reference, bool delta,
+                           ProjectFile::ChunkEncoding compression, const Palette* palette, QByteArray& chunk)
+{
+    if(reference >= 0)
+    {
+        chunk.resize(referenceSize);
+        qToLittleEndian<quint32>(reference, chunk.data());
+        return ProjectFile::ReferenceChunk;
+    }
+    const Frame& frame = frames[frameIndex];
+    bool indexed = false;
+    if(delta)
+    {
+        indexed = encodeDelta(frames[frameIndex - 1], frame, palette, chunk);
+    }
+    else
+    {
+        if(palette != nullptr)
+        {
+            QImage image = frame.getImage();
+            chunk.resize(palette->rowBytes(image.width()) * image.height());
+            indexed = packIndices(image, image.rect(), *palette, (uchar*)chunk.data());
+        }
+        if(!indexed)
+        {
+            chunk.resize(frame.rawSize());
+            frame.writeRaw((uchar*)chunk.data());
+        }
+    }
+    if(compression == ProjectFile::ZlibChunk)
+    {
+        chunk = qCompress(chunk, compressionLevel);
+    }
+    return compression | (delta ? ProjectFile::DeltaChunk : 0) | (indexed ? ProjectFile::IndexedChunk : 0);
+}
+
+static void encodeIndexEntry(QByteArray& index, int frameIndex, quint64 offset, quint32 size, quint16 encoding)
+{
+    uchar* entry = (uchar*)index.data() + frameIndex * ProjectFile::indexEntrySize;
+    qToLittleEndian<quint64>(offset, entry);
+    qToLittleEndian<quint32>(size, entry + 8);
+    qToLittleEndian<quint16>(encoding, entry + 12);
+}
+
+bool ProjectFile::write(QIODevice& device, const std::vector<Frame>& frames, int width, int height,
+                        const WriteOptions& options)
+{
+    const quint32 frameCount = (quint32)frames.size();
+
+    // Lazily opened frames are decoded up front; a delta encode reads two frames, so
+    // encoders could otherwise race to load the same one
+    Frame::loadAll(frames);
+
+    // Repeated frames are stored once and referred to by index
+    std::vector<int> everyFrame(frameCount);
+    for(quint32 i = 0; i < frameCount; i++)
+    {
+        everyFrame[i] = i;
+    }
+    std::vector<int> references;
+    findDuplicates(frames, everyFrame, references);
+
+    // The palette table sits between the header and the first chunk
+    Palette palette;
+    const bool indexed = options.usePalette && findPalette(frames, palette);
+    if(indexed)
+    {
+        palette.offset = headerSize;
+    }
+
+    // The header is written again once the chunks are down and the index offset is known
+    Thumbnail thumbnail;
+    if(!device.seek(0) || device.write(encodeHeader(width, height, frameCount, 0, palette, thumbnail)) != headerSize)
+    {
+        return false;
+    }
+    QByteArray table = encodePalette(palette);
+    thumbnail.offset = headerSize + table.size();
+    thumbnail.png = encodeThumbnail(frames);
+    if(device.write(table) != table.size() || device.write(thumbnail.png) != thumbnail.png.size())
+    {
+        return false;
+    }
+
+    QByteArray index(frameCount * indexEntrySize, '\0');
+    std::vector<quint16> encodings(frameCount);
+    quint64 chunkOffset = thumbnail.offset + thumbnail.png.size();
+    bool written = encodeFramesInOrder(device, frameCount,
+        [&frames, &options, &encodings, &references, &palette, indexed](int frameIndex, QByteArray& chunk){
+            encodings[frameIndex] = encodeFrame(frames, frameIndex, references[frameIndex],
+                                                isDeltaFrame(frameIndex, options), options.compression,
+                                                indexed ? &palette : nullptr, chunk);
+        },
+        [&index, &chunkOffset, &encodings](int frameIndex, const QByteArray& chunk){
+            encodeIndexEntry(index, frameIndex, chunkOffset, chunk.size(), encodings[frameIndex]);
+            chunkOffset += chunk.size();
+        });
+    if(!written || device.write(index) != index.size())
+    {
+        return false;
+    }
+
+    const qint64 end = device.pos();
+    if(!device.seek(0)
+            || device.write(encodeHeader(width, height, frameCount, chunkOffset, palette, thumbnail)) != headerSize)
+    {
+        return false;
+    }
+    return device.seek(end);
+}
+
+/**
+ * @brief readIndex validates the header of a binary project and loads its chunk index,
+ * palette and thumbnail
+ * @return false, after a warning where useful, if the file isn't a valid binary project
+ */
+static bool readIndex(QIODevice& device, quint32& width, quint32& height, std::vector<ChunkJob>& jobs,
+                      Palette& palette, Thumbnail& thumbnail)
+{
+    if(!device.seek(0))
+    {
+        return false;
+    }
+    QByteArray header = device.read(ProjectFile::headerSize);
+    if(header.size() != ProjectFile::headerSize || !ProjectFile::isBinaryProject(header))
+    {
+        return false;
+    }
+    const uchar* h = (const uchar*)header.constData();
+    quint16 version = qFromLittleEndian<quint16>(h + 4);
+    quint16 storedHeaderSize = qFromLittleEndian<quint16>(h + 6);
+    width = qFromLittleEndian<quint32>(h + 8);
+    height = qFromLittleEndian<quint32>(h + 12);
+    quint32 frameCount = qFromLittleEndian<quint32>(h + 16);
+    quint64 indexOffset = qFromLittleEndian<quint64>(h + 24);
+    // Version 1 files leave the palette fields zeroed
+    palette.offset = qFromLittleEndian<quint64>(h + 32);
+    quint16 paletteSize = qFromLittleEndian<quint16>(h + 40);
+
+    if(version > ProjectFile::currentVersion || storedHeaderSize < ProjectFile::headerSize)
+    {
+        qWarning("Unsupported binary project version.");
+        return false;
+    }
+    if(width == 0 || height == 0 || width > maxFrameSide || height > maxFrameSide)
+    {
+        qWarning("Binary project has invalid dimensions.");
+        return false;
+    }
+    if((quint64)frameCount * ProjectFile::indexEntrySize > (quint64)device.size())
+    {
+        qWarning("Binary project index is truncated.");
+        return false;
+    }
+    if(!readThumbnail(device, header, thumbnail))
+    {
+        return false;
+    }
+
+    const quint64 fileSize = device.size();
+    palette.colors.clear();
+    if(paletteSize > 0)
+    {
+        if(paletteSize > maxPaletteSize || palette.offset > fileSize
+                || paletteSize * 4u > fileSize - palette.offset || !device.seek(palette.offset))
+        {
+            qWarning("Binary project has an invalid palette.");
+            return false;
+        }
+        QByteArray table = device.read(paletteSize * 4);
+        palette.colors.resize(paletteSize);
+        qFromLittleEndian<quint32>(table.constData(), paletteSize, palette.colors.data());
+    }
+
+    if(!device.seek(indexOffset))
+    {
+        return false;
+    }
+    QByteArray index = device.read((qint64)frameCount * ProjectFile::indexEntrySize);
+    if(index.size() != (int)(frameCount * ProjectFile::indexEntrySize))
+    {
+        qWarning("Binary project index is truncated.");
+        return false;
+    }
+
+    jobs.clear();
+    jobs.resize(frameCount);
+    for(quint32 i = 0; i < frameCount; i++)
+    {
+        const uchar* entry = (const uchar*)index.constData() + i * ProjectFile::indexEntrySize;
+        ChunkJob& job = jobs[i];
+        job.offset = qFromLittleEndian<quint64>(entry);
+        job.size = qFromLittleEndian<quint32>(entry + 8);
+        job.encoding = qFromLittleEndian<quint16>(entry + 12);
+        if(job.offset > fileSize || job.size > fileSize - job.offset)
+        {
+            qWarning("Binary project has a truncated frame chunk.");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ProjectFile::read(QIODevice& device, std::vector<Frame>& frames, int& width, int& height,
+                       const ReadProgress* progress)
+{
+    quint32 storedWidth;
+    quint32 storedHeight;
+    std::vector<ChunkJob> jobs;
+    Palette palette;
+    Thumbnail thumbnail;
+    if(!readIndex(device, storedWidth, storedHeight, jobs, palette, thumbnail))
+    {
+        return false;
+    }
+    const quint32 frameCount = (quint32)jobs.size();
+
+    // Chunks are decoded straight out of the mapped file when possible, otherwise each one
+    // is read in turn; either way the decoding itself runs on the global thread pool
+    QFileDevice* file = qobject_cast<QFileDevice*>(&device);
+    uchar* mapped = file != nullptr ? file->map(0, device.size()) : nullptr;
+    for(ChunkJob& job : jobs)
+    {
+        if(mapped != nullptr)
+        {
+            job.data = mapped + job.offset;
+        }
+        else
+        {
+            device.seek(job.offset);
+            job.bytes = device.read(job.size);
+            if(job.bytes.size() != (int)job.size)
+            {
+                qWarning("Binary project has a truncated frame chunk.");
+                return false;
+            }
+            job.data = (const uchar*)job.bytes.constData();
+        }
+    }
+
+    std::atomic<qint64> bytesRead(headerSize);
+    std::atomic<int> chunksDecoded(0);
+    std::atomic<bool> cancelled(false);
+    QtConcurrent::blockingMap(jobs, [&, storedWidth, storedHeight](ChunkJob& job){
+        if(cancelled)
+        {
+            return;
+        }
+        job.decoded = decodeChunk(job, storedWidth, storedHeight, palette);
+        job.bytes = QByteArray();
+        if(progress != nullptr && !progress->report(bytesRead += job.size, ++chunksDecoded))
+        {
+            cancelled = true;
+        }
+    });
+    if(mapped != nullptr)
+    {
+        file->unmap(mapped);
+    }
+    if(cancelled)
+    {
+        return false;
+    }
+
+    // Deltas depend on the frame before them, so they are applied in order once every
+    // chunk has been inflated. Repeated frames share the image of the frame they repeat
+    for(quint32 i = 0; i < frameCount; i++)
+    {
+        ChunkJob& job = jobs[i];
+        if(job.decoded && job.reference >= 0)
+        {
+            job.decoded = job.reference < i;
+            if(job.decoded)
+            {
+                job.image = jobs[job.reference].image;
+            }
+        }
+        else if(job.decoded && (job.encoding & DeltaChunk))
+        {
+            job.decoded = i > 0 && applyDelta(jobs[i - 1].image, job.delta, job.encoding & IndexedChunk,
+                                              palette, job.image);
+            job.delta = QByteArray();
+        }
+        if(!job.decoded)
+        {
+            qWarning("Binary project has a corrupt frame chunk.");
+            return false;
+        }
+        if(i == 0 && progress != nullptr)
+        {
+            progress->reportFirstFrame(job.image);
+        }
+    }
+
+    width = storedWidth;
+    height = storedHeight;
+    frames.clear();
+    frames.reserve(frameCount);
+    for(const ChunkJob& job : jobs)
+    {
+        frames.push_back(Frame(job.image));
+    }
+    return true;
+}
+
+/**
+ * @brief storedReference reads the index of the frame a reference chunk in the file repeats
+ * @return the frame index, or -1 if the chunk can't be read
+ */
+static qint64 storedReference(QIODevice& device, const ChunkJob& chunk)
+{
+    if(chunk.size != referenceSize || !device.seek(chunk.offset))
+    {
+        return -1;
+    }
+    QByteArray payload = device.read(referenceSize);
+    if(payload.size() != referenceSize)
+    {
+        return -1;
+    }
+    return qFromLittleEndian<quint32>(payload.constData());
+}
+
+bool ProjectFile::append(QIODevice& device, const std::vector<Frame>& frames, const std::vector<int>& savedChunks,
+                         int width, int height, const WriteOptions& options)
+{
+    quint32 storedWidth;
+    quint32 storedHeight;
+    std::vector<ChunkJob> chunks;
+    Palette palette;
+    Thumbnail thumbnail;
+    if(savedChunks.size() != frames.size() || !readIndex(device, storedWidth, storedHeight, chunks, palette, thumbnail)
+            || storedWidth != (quint32)width || storedHeight != (quint32)height)
+    {
+        return false;
+    }
+    // The file's palette can't grow in place, so a new chunk is indexed only if its colors
+    // are already in it
+    palette.buildIndices();
+    const Palette* chunkPalette = options.usePalette && !palette.colors.empty() ? &palette : nullptr;
+
+    // A stored chunk is kept if its frame hasn't changed and, for a delta, the frame before it
+    // is still the one it was diffed against, or for a reference, the frame it repeats is
+    // still unchanged at the same index. Everything else gets a new chunk
+    const int frameCount = (int)frames.size();
+    QByteArray index(frameCount * indexEntrySize, '\0');
+    std::vector<int> pending;
+    std::vector<bool> kept(frameCount, false);
+    for(int i = 0; i < frameCount; i++)
+    {
+        const int chunk = savedChunks[i];
+        bool keep = chunk >= 0 && chunk < (int)chunks.size();
+        if(keep && (chunks[chunk].encoding & DeltaChunk))
+        {
+            keep = i > 0 && savedChunks[i - 1] == chunk - 1;
+        }
+        if(keep && (chunks[chunk].encoding & 0xff) == ReferenceChunk)
+        {
+            const qint64 target = storedReference(device, chunks[chunk]);
+            keep = target >= 0 && target < i && savedChunks[target] == target;
+        }
+        if(keep)
+        {
+            kept[i] = true;
+            encodeIndexEntry(index, i, chunks[chunk].offset, chunks[chunk].size, chunks[chunk].encoding);
+        }
+        else
+        {
+            pending.push_back(i);
+        }
+    }
+
+    // Only frames getting a new chunk, and the frames they may be diffed against, need their pixels
+    for(int frameIndex : pending)
+    {
+        frames[frameIndex].load();
+        if(frameIndex > 0 && options.keyframeInterval > 0)
+        {
+            frames[frameIndex - 1].load();
+        }
+    }
+
+    // A new chunk can refer to any earlier frame whose pixels are already in memory
+    std::vector<int> loaded;
+    for(int i = 0; i < frameCount; i++)
+    {
+        if(frames[i].isLoaded())
+        {
+            loaded.push_back(i);
+        }
+    }
+    std::vector<int> references;
+    findDuplicates(frames, loaded, references);
+
+    // A new chunk is a delta only while the chain back to a keyframe stays shorter than the
+    // keyframe interval
+    std::vector<bool> delta(frameCount, false);
+    std::vector<int> chainLength(frameCount, 0);
+    for(int i = 0; i < frameCount; i++)
+    {
+        if(kept[i])
+        {
+            delta[i] = chunks[savedChunks[i]].encoding & DeltaChunk;
+        }
+        else
+        {
+            delta[i] = references[i] < 0 && options.keyframeInterval > 0 && i > 0
+                    && chainLength[i - 1] + 1 < options.keyframeInterval;
+        }
+        chainLength[i] = delta[i] ? chainLength[i - 1] + 1 : 0;
+    }
+
+    quint64 chunkOffset = device.size();
+    if(!device.seek(chunkOffset))
+    {
+        return false;
+    }
+    std::vector<quint16> encodings(pending.size());
+    bool written = encodeFramesInOrder(device, (int)pending.size(),
+        [&frames, &options, &pending, &references, &delta, &encodings, chunkPalette](int slot, QByteArray& chunk){
+            const int frameIndex = pending[slot];
+            encodings[slot] = encodeFrame(frames, frameIndex, references[frameIndex], delta[frameIndex],
+                                          options.compression, chunkPalette, chunk);
+        },
+        [&index, &chunkOffset, &pending, &encodings](int slot, const QByteArray& chunk){
+            encodeIndexEntry(index, pending[slot], chunkOffset, chunk.size(), encodings[slot]);
+            chunkOffset += chunk.size();
+        });
+    if(!written)
+    {
+        return false;
+    }
+
+    // The thumbnail shows frame 0, so it is only appended again when that frame changed
+    if(frames.empty() || savedChunks[0] != 0 || thumbnail.png.isEmpty())
+    {
+        thumbnail.offset = chunkOffset;
+        thumbnail.png = encodeThumbnail(frames);
+        if(device.write(thumbnail.png) != thumbnail.png.size())
+        {
+            return false;
+        }
+        chunkOffset += thumbnail.png.size();
+    }
+    if(device.write(index) != index.size())
+    {
+        return false;
+    }
+
+    // The new index only takes effect once the header points at it, so a save that is cut
+    // short leaves the file as it was
+    QFileDevice* file = qobject_cast<QFileDevice*>(&device);
+    if(file != nullptr && !file->flush())
+    {
+        return false;
+    }
+    const qint64 end = device.pos();
+    if(!device.seek(0)
+            || device.write(encodeHeader(width, height, frameCount, chunkOffset, palette, thumbnail)) != headerSize)
+    {
+        return false;
+    }
+    return device.seek(end);
+}
+
+bool ProjectFile::needsCompaction(QIODevice& device)
+{
+    quint32 width;
+    quint32 height;
+    std::vector<ChunkJob> chunks;
+    Palette palette;
+    Thumbnail thumbnail;
+    if(!readIndex(device, width, height, chunks, palette, thumbnail))
+    {
+        return true;
+    }
+    quint64 live = headerSize + palette.colors.size() * 4 + thumbnail.png.size() + chunks.size() * indexEntrySize;
+    for(const ChunkJob& chunk : chunks)
+    {
+        live += chunk.size;
+    }
+    return (quint64)device.size() > live * 2;
+}
+
+/**
+ * @brief MappedProject keeps an opened binary project mapped for as long as any of its frames
+ * still has to be decoded. Frames hold it through their loaders, so the mapping is released
+ * once the last of them has been decoded or dropped.
+ */
+class MappedProject
+{
+public:
+    QFile file;
+    const uchar* data = nullptr;
+    quint32 width = 0;
+    quint32 height = 0;
+    std::vector<ChunkJob> chunks;
+    Palette palette;
+    Thumbnail thumbnail;
+    // Whether a reference chunk repeats each frame, so its image is kept to be shared
+    std::vector<bool> referenced;
+
+    ~MappedProject()
+    {
+        if(data != nullptr)
+        {
+            file.unmap((uchar*)data);
+        }
+    }
+
+    /**
+     * @brief decode produces the pixels of one frame, walking a delta frame back to its
+     * keyframe. Safe to call from several threads at once
+     * @param frameIndex the frame to decode
+     * @return the frame's pixels, or a blank frame if its chunk is corrupt
+     */
+    QImage decode(int frameIndex);
+
+private:
+    // The last frame decoded, so a delta chain viewed in order costs one delta per frame
+    QMutex cacheMutex;
+    int cachedIndex = -1;
+    QImage cachedImage;
+    // The decoded images of referenced frames, handed to every frame that repeats them
+    QHash<int, QImage> shared;
+};
+
+QImage MappedProject::decode(int frameIndex)
+{
+    if(referenced[frameIndex])
+    {
+        QMutexLocker locker(&cacheMutex);
+        QHash<int, QImage>::const_iterator found = shared.constFind(frameIndex);
+        if(found != shared.constEnd())
+        {
+            return found.value();
+        }
+    }
+
+    int first = frameIndex;
+    while(first > 0 && (chunks[first].encoding & ProjectFile::DeltaChunk))
+    {
+        first--;
+    }
+
+    QImage image;
+    int next = first;
+    {
+        QMutexLocker locker(&cacheMutex);
+        if(cachedIndex >= first && cachedIndex <= frameIndex)
+        {
+            image = cachedImage;
+            next = cachedIndex + 1;
+        }
+    }
+
+    for(; next <= frameIndex; next++)
+    {
+        // Each call decodes into its own job, the shared index is only read
+        ChunkJob job;
+        job.size = chunks[next].size;
+        job.encoding = chunks[next].encoding;
+        job.data = data + chunks[next].offset;
+        bool decoded = decodeChunk(job, width, height, palette);
+        if(decoded && job.reference >= 0)
+        {
+            decoded = job.reference < next;
+            if(decoded)
+            {
+                job.image = decode(job.reference);
+            }
+        }
+        else if(decoded && (job.encoding & ProjectFile::DeltaChunk))
+        {
+            decoded = !image.isNull() && applyDelta(image, job.delta, job.encoding & ProjectFile::IndexedChunk,
+                                                    palette, job.image);
+        }
+        if(!decoded)
+        {
+            qWarning("Binary project has a corrupt frame chunk.");
+            return Frame(width, height).getImage();
+        }
+        image = job.image;
+    }
+
+    QMutexLocker locker(&cacheMutex);
+    cachedIndex = frameIndex;
+    cachedImage = image;
+    if(referenced[frameIndex])
+    {
+        // Another thread may have decoded the frame first; every copy must share one image
+        QHash<int, QImage>::const_iterator found = shared.constFind(frameIndex);
+        if(found != shared.constEnd())
+        {
+            return found.value();
+        }
+        shared.insert(frameIndex, image);
+    }
+    return image;
+}
+
+bool ProjectFile::open(const QString& filepath, std::vector<Frame>& frames, int& width, int& height,
+                       const ReadProgress* progress)
+{
+    std::shared_ptr<MappedProject> project = std::make_shared<MappedProject>();
+    project->file.setFileName(filepath);
+    if(!project->file.open(QIODevice::ReadOnly)
+            || !readIndex(project->file, project->width, project->height, project->chunks, project->palette,
+                          project->thumbnail))
+    {
+        return false;
+    }
+    project->data = project->file.map(0, project->file.size());
+    if(project->data == nullptr)
+    {
+        // Some file systems can't be mapped; decode every frame up front instead
+        return read(project->file, frames, width, height, progress);
+    }
+
+    project->referenced.assign(project->chunks.size(), false);
+    for(const ChunkJob& chunk : project->chunks)
+    {
+        if((chunk.encoding & 0xff) == ReferenceChunk && chunk.size == referenceSize)
+        {
+            quint32 target = qFromLittleEndian<quint32>(project->data + chunk.offset);
+            if(target < project->referenced.size())
+            {
+                project->referenced[target] = true;
+            }
+        }
+    }
+
+    width = project->width;
+    height = project->height;
+    frames.clear();
+    frames.reserve(project->chunks.size());
+    for(int i = 0; i < (int)project->chunks.size(); i++)
+    {
+        frames.push_back(Frame(std::function<QImage()>([project, i](){
+            return project->decode(i);
+        })));
+    }
+
+    // Only the frame shown first is decoded now, the rest as they are viewed
+    if(progress != nullptr && !frames.empty())
+    {
+        frames[0].load();
+        progress->reportFirstFrame(frames[0].getImage());
+        if(!progress->report(project->file.size(), 1))
+        {
+            frames.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ProjectFile::probe(const QString& filepath, Info& info)
+{
+    QFile file(filepath);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    QByteArray header = file.read(headerSize);
+    if(header.size() != headerSize || !isBinaryProject(header))
+    {
+        return false;
+    }
+    const uchar* h = (const uchar*)header.constData();
+    info.version = qFromLittleEndian<quint16>(h + 4);
+    info.width = qFromLittleEndian<quint32>(h + 8);
+    info.height = qFromLittleEndian<quint32>(h + 12);
+    info.frameCount = qFromLittleEndian<quint32>(h + 16);
+    Thumbnail thumbnail;
+    if(info.version > currentVersion || !readThumbnail(file, header, thumbnail))
+    {
+        return false;
+    }
+    info.thumbnail = thumbnail.png.isEmpty() ? QImage() : QImage::fromData(thumbnail.png, "PNG");
+    return true;
+}
@@ -0,0 +1,188 @@
+#ifndef PROJECTFILE_H
+#define PROJECTFILE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QString>
+#include <QImage>
+#include <vector>
+#include "frame.h"
+#include "readprogress.h"
+
+/**
+ * @brief ProjectFile reads and writes the binary chunked .ssp container. All integers
+ * are little-endian and the file is laid out as:
+ *
+ *   Header    64 bytes: magic "SSPB", version, header size, width, height,
+ *             frame count, offset of the frame index, offset and size of the palette,
+ *             checksum, offset and size of the thumbnail
+ *   Palette   4 bytes per color, present when the project uses 256 colors or fewer
+ *   Thumbnail frame 0 as a PNG, downscaled to fit thumbnailSide
+ *   Chunks    the pixel payload of each frame, one after another
+ *   Index     16 bytes per frame: chunk offset, chunk size, chunk encoding
+ *
+ * The index follows the chunks so they can be encoded before their sizes are known. Every
+ * header field sits at a fixed position, so probe can describe a project, thumbnail included,
+ * from its first few hundred bytes. The checksum is the CRC-32 of the header, with the
+ * checksum field zeroed, followed by the thumbnail.
+ *
+ * A raw chunk is the frame's scanlines as 32-bit ARGB pixels, so it can be copied
+ * straight in and out of the frame's QImage. A zlib chunk is the same payload passed
+ * through qCompress; each chunk is compressed on its own so frames still encode and
+ * decode in parallel, and so a frame can be decoded on its own when it is first shown.
+ *
+ * A delta chunk stores only what changed since the previous frame: the bounding rectangle
+ * of the changes (x, y, width, height) followed by that rectangle's pixels XORed with the
+ * previous frame's. Unchanged pixels inside the rectangle become zero, which compresses
+ * to almost nothing. Every keyframeInterval frames a full keyframe is stored instead.
+ *
+ * An indexed chunk stores palette indices in place of pixels: 8 bits each, or 4 bits packed
+ * two to a byte when the palette has 16 colors or fewer, each row padded to a whole byte.
+ * A full frame is its index plane; a delta keeps the changed rectangle but stores the
+ * indices of the new pixels rather than an XOR.
+ *
+ * A reference chunk stores no pixels at all, only the index of an earlier frame with exactly
+ * the same pixels, so held and looping frames are saved once. Frames are hashed while saving
+ * and only frames with equal hashes are compared. When loaded, a reference shares the image
+ * of the frame it points at until either of them is edited.
+ *
+ * Because the header is the only thing that locates the index, a project can also be saved
+ * as a journal: the chunks of changed frames and a fresh index are appended to the end of
+ * the file, then the header is pointed at the new index. Chunks of unchanged frames stay
+ * where they are. Superseded chunks and indexes are dead space until the project is
+ * compacted by writing it out again in full.
+ */
+class ProjectFile
+{
+public:
+    /**
+     * @brief The ChunkEncoding enum defines how the payload of a frame chunk is stored. The
+     * low byte of a chunk's encoding is its compression, or ReferenceChunk for a frame that
+     * repeats an earlier one; the bits above it are flags
+     */
+    enum ChunkEncoding{
+        RawChunk = 0,
+        ZlibChunk = 1,
+        ReferenceChunk = 2,
+        DeltaChunk = 0x100,
+        IndexedChunk = 0x200
+    };
+
+    /**
+     * @brief The WriteOptions struct selects how the frame chunks of a project are stored
+     */
+    struct WriteOptions
+    {
+        ChunkEncoding compression;
+        // Every this many frames a full keyframe is stored, the rest are deltas; 0 disables deltas
+        int keyframeInterval;
+        // Store palette indices instead of pixels when the frames use 256 colors or fewer
+        bool usePalette;
+
+        WriteOptions() : compression(RawChunk), keyframeInterval(0), usePalette(false) {}
+    };
+
+    /**
+     * @brief The Info struct describes a binary project as read from its header by probe
+     */
+    struct Info
+    {
+        quint16 version;
+        int width;
+        int height;
+        int frameCount;
+        // Frame 0 scaled to fit thumbnailSide; null for files saved before thumbnails existed
+        QImage thumbnail;
+
+        Info() : version(0), width(0), height(0), frameCount(0) {}
+    };
+
+    static const quint16 currentVersion = 3;
+    static const int headerSize = 64;
+    static const int indexEntrySize = 16;
+    static const int thumbnailSide = 64;
+
+    /**
+     * @brief isBinaryProject checks whether the given leading bytes of a file carry the
+     * binary .ssp magic
+     * @param leadingBytes at least the first four bytes of the file
+     * @return true if the file is a binary project, false if it should be read as JSON
+     */
+    static bool isBinaryProject(const QByteArray& leadingBytes);
+
+    /**
+     * @brief probe reads only the header and thumbnail of a binary project, cheap enough to
+     * describe every project in a directory
+     * @param filepath the .ssp file to describe
+     * @param info filled from the header
+     * @return a true/false on whether the file is a binary project with an intact header
+     */
+    static bool probe(const QString& filepath, Info& info);
+
+    /**
+     * @brief write stores the given frames to the device as a binary project
+     * @param device an open, writable device
+     * @param frames the frames of the Sprite, in order
+     * @param width the width of every frame
+     * @param height the height of every frame
+     * @param options how each frame's chunk is stored
+     * @return a true/false on whether every byte could be written
+     */
+    static bool write(QIODevice& device, const std::vector<Frame>& frames, int width, int height,
+                      const WriteOptions& options = WriteOptions());
+
+    /**
+     * @brief append saves frames into the binary project already on the device by appending
+     * chunks for the frames that changed plus a new index, then pointing the header at it.
+     * The previous index stays valid until that final header write
+     * @param device an open, readable and writable device holding a binary project
+     * @param frames the frames of the Sprite, in order
+     * @param savedChunks for each frame, the index of the chunk in the file that already holds
+     * its pixels, or -1 if the frame is new or has changed since
+     * @param width the width of every frame; must match the file
+     * @param height the height of every frame; must match the file
+     * @param options how each new chunk is stored
+     * @return a true/false on whether the frames were saved
+     */
+    static bool append(QIODevice& device, const std::vector<Frame>& frames, const std::vector<int>& savedChunks,
+                       int width, int height, const WriteOptions& options = WriteOptions());
+
+    /**
+     * @brief needsCompaction checks whether superseded chunks left behind by append take up
+     * more than half of a binary project, or whether it isn't one at all
+     * @param device an open, readable device
+     * @return true if the project should be written out again in full
+     */
+    static bool needsCompaction(QIODevice& device);
+
+    /**
+     * @brief read populates frames from a binary project on the device
+     * @param device an open, readable device positioned anywhere
+     * @param frames cleared, then filled with one Frame per frame in the file
+     * @param width set to the width stored in the header
+     * @param height set to the height stored in the header
+     * @param progress if given, told of the bytes read and frames decoded as the read goes on
+     * @return a true/false on whether the file was a valid binary project and the read wasn't
+     * cancelled
+     */
+    static bool read(QIODevice& device, std::vector<Frame>& frames, int& width, int& height,
+                     const ReadProgress* progress = nullptr);
+
+    /**
+     * @brief open maps a binary project and fills frames with placeholders that decode their
+     * chunk the first time they are accessed, so opening costs the same however many frames
+     * there are. The file stays mapped until every frame has been decoded or destroyed; call
+     * Frame::loadAll before overwriting it
+     * @param filepath the .ssp file to open
+     * @param frames cleared, then filled with one lazily decoded Frame per frame in the file
+     * @param width set to the width stored in the header
+     * @param height set to the height stored in the header
+     * @param progress if given, handed frame 0, which is decoded straight away
+     * @return a true/false on whether the file was a valid binary project and the open wasn't
+     * cancelled
+     */
+    static bool open(const QString& filepath, std::vector<Frame>& frames, int& width, int& height,
+                     const ReadProgress* progress = nullptr);
+};
+
+#endif // PROJECTFILE_H
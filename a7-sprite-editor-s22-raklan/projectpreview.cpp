@@ -0,0 +1,122 @@
+#include "projectpreview.h"
+#include "projectfile.h"
+#include <QFileInfo>
+#include <QIconEngine>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QPixmap>
+#include <QVBoxLayout>
+
+// Side of the square the preview's thumbnail is scaled into
+static const int previewSide = 128;
+
+/**
+ * @brief ThumbnailIconEngine draws a project's thumbnail as an icon. It holds only the image,
+ * which is safe to make on any thread, and makes pixmaps when the icon is drawn, which is
+ * always on the GUI thread
+ */
+class ThumbnailIconEngine : public QIconEngine
+{
+public:
+    explicit ThumbnailIconEngine(const QImage& _thumbnail) : thumbnail(_thumbnail) {}
+
+    void paint(QPainter* painter, const QRect& rect, QIcon::Mode mode, QIcon::State state) override
+    {
+        QSize size = actualSize(rect.size(), mode, state);
+        QRect target(QPoint(0, 0), size);
+        target.moveCenter(rect.center());
+        painter->drawImage(target, thumbnail);
+    }
+
+    QPixmap pixmap(const QSize& size, QIcon::Mode mode, QIcon::State state) override
+    {
+        // Sprites are scaled without smoothing so their pixels stay sharp
+        return QPixmap::fromImage(thumbnail.scaled(actualSize(size, mode, state), Qt::IgnoreAspectRatio,
+                                                   Qt::FastTransformation));
+    }
+
+    QSize actualSize(const QSize& size, QIcon::Mode, QIcon::State) override
+    {
+        return thumbnail.size().scaled(size, Qt::KeepAspectRatio);
+    }
+
+    QIconEngine* clone() const override
+    {
+        return new ThumbnailIconEngine(thumbnail);
+    }
+
+private:
+    QImage thumbnail;
+};
+
+QIcon ProjectIconProvider::icon(const QFileInfo& info) const
+{
+    if(!info.isFile() || info.suffix().compare("ssp", Qt::CaseInsensitive) != 0)
+    {
+        return QFileIconProvider::icon(info);
+    }
+
+    const QString path = info.absoluteFilePath();
+    const QDateTime modified = info.lastModified();
+    QImage thumbnail;
+    bool cached = false;
+    {
+        QMutexLocker locker(&cacheMutex);
+        QHash<QString, CachedThumbnail>::const_iterator found = cache.constFind(path);
+        if(found != cache.constEnd() && found.value().modified == modified)
+        {
+            thumbnail = found.value().thumbnail;
+            cached = true;
+        }
+    }
+
+    if(!cached)
+    {
+        ProjectFile::Info project;
+        if(ProjectFile::probe(path, project))
+        {
+            thumbnail = project.thumbnail;
+        }
+        QMutexLocker locker(&cacheMutex);
+        cache.insert(path, CachedThumbnail{modified, thumbnail});
+    }
+    return thumbnail.isNull() ? QFileIconProvider::icon(info) : QIcon(new ThumbnailIconEngine(thumbnail));
+}
+
+ProjectPreview::ProjectPreview(QWidget* parent)
+    : QWidget(parent)
+    , thumbnailLabel(new QLabel(this))
+    , detailsLabel(new QLabel(this))
+{
+    thumbnailLabel->setFixedSize(previewSide, previewSide);
+    thumbnailLabel->setAlignment(Qt::AlignCenter);
+    detailsLabel->setAlignment(Qt::AlignCenter);
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(thumbnailLabel);
+    layout->addWidget(detailsLabel);
+    layout->addStretch();
+}
+
+void ProjectPreview::showProject(const QString& filepath)
+{
+    ProjectFile::Info project;
+    if(!ProjectFile::probe(filepath, project))
+    {
+        thumbnailLabel->clear();
+        detailsLabel->clear();
+        return;
+    }
+
+    if(project.thumbnail.isNull())
+    {
+        thumbnailLabel->setText("No preview");
+    }
+    else
+    {
+        // Sprites are scaled without smoothing so their pixels stay sharp
+        QImage thumbnail = project.thumbnail.scaled(previewSide, previewSide, Qt::KeepAspectRatio,
+                                                    Qt::FastTransformation);
+        thumbnailLabel->setPixmap(QPixmap::fromImage(thumbnail));
+    }
+    detailsLabel->setText(QString("%1 x %2\n%3 frames").arg(project.width).arg(project.height).arg(project.frameCount));
+}
@@ -0,0 +1,70 @@
+#ifndef PROJECTPREVIEW_H
+#define PROJECTPREVIEW_H
+
+#include <QFileIconProvider>
+#include <QWidget>
+#include <QLabel>
+#include <QHash>
+#include <QMutex>
+#include <QDateTime>
+#include <QImage>
+
+/**
+ * @brief ProjectIconProvider gives every binary project in a file dialog its embedded thumbnail
+ * as an icon. Only the header and thumbnail of each project are read, once per modification,
+ * so a directory of hundreds of projects lists as fast as any other.
+ */
+class ProjectIconProvider : public QFileIconProvider
+{
+public:
+    using QFileIconProvider::icon;
+
+    /**
+     * @brief icon returns the thumbnail of a binary project, or the usual icon for anything else.
+     * The file dialog calls this from its own thread, where pixmaps can't always be made, so
+     * the thumbnail is kept as an image and only turned into a pixmap when the icon is drawn
+     * @param info the file to find an icon for
+     * @return the icon to show next to the file
+     */
+    QIcon icon(const QFileInfo& info) const override;
+
+private:
+    struct CachedThumbnail
+    {
+        QDateTime modified;
+        // Null if the file isn't a binary project or has no thumbnail
+        QImage thumbnail;
+    };
+
+    mutable QMutex cacheMutex;
+    mutable QHash<QString, CachedThumbnail> cache;
+};
+
+/**
+ * @brief ProjectPreview is the side panel of the open dialog: the thumbnail of the selected
+ * project with its size and frame count beneath
+ */
+class ProjectPreview : public QWidget
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief ProjectPreview creates an empty preview
+     * @param parent the Parent widget of this object
+     */
+    explicit ProjectPreview(QWidget* parent = nullptr);
+
+public slots:
+    /**
+     * @brief showProject probes the given file and shows its thumbnail and details, or clears
+     * the preview if it isn't a binary project
+     * @param filepath the file selected in the dialog
+     */
+    void showProject(const QString& filepath);
+
+private:
+    QLabel* thumbnailLabel;
+    QLabel* detailsLabel;
+};
+
+#endif // PROJECTPREVIEW_H
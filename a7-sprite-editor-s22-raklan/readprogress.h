@@ -0,0 +1,41 @@
+#ifndef READPROGRESS_H
+#define READPROGRESS_H
+
+#include <QImage>
+#include <functional>
+
+/**
+ * @brief ReadProgress is handed to the project readers so a read running on a worker thread
+ * can report how far it has got, hand over the first frame early, and be cancelled. Both
+ * callbacks are optional, and may be called from several of the reader's threads at once.
+ */
+struct ReadProgress
+{
+    // Called with the bytes of the file consumed and the frames decoded so far; the read is
+    // abandoned once it returns false
+    std::function<bool(qint64 bytesRead, int framesDecoded)> update;
+    // Called once with the pixels of frame 0 as soon as they are decoded
+    std::function<void(const QImage& frame)> firstFrame;
+
+    /**
+     * @brief report passes progress to update, if set
+     * @return false if the read should stop
+     */
+    bool report(qint64 bytesRead, int framesDecoded) const
+    {
+        return !update || update(bytesRead, framesDecoded);
+    }
+
+    /**
+     * @brief reportFirstFrame passes frame 0 to firstFrame, if set
+     */
+    void reportFirstFrame(const QImage& frame) const
+    {
+        if(firstFrame)
+        {
+            firstFrame(frame);
+        }
+    }
+};
+
+#endif // READPROGRESS_H
@@ -0,0 +1,239 @@
+#include "spritesheet.h"
+#include "pixelscaler.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/**
+ * @brief opaqueRect finds the bounding rectangle of every pixel that isn't fully transparent
+ * @return the rectangle, or an empty rectangle if the image is fully transparent
+ */
+static QRect opaqueRect(const QImage& image)
+{
+    const int width = image.width();
+    const int height = image.height();
+    int top = -1, bottom = -1, left = width, right = -1;
+    for(int y = 0; y < height; y++)
+    {
+        const QRgb* row = (const QRgb*)image.constScanLine(y);
+        int first = 0;
+        while(first < width && qAlpha(row[first]) == 0)
+        {
+            first++;
+        }
+        if(first == width)
+        {
+            continue;
+        }
+        // From the right only the columns beyond those already known to be opaque matter
+        int last = width - 1;
+        while(last > std::max(first, right) && qAlpha(row[last]) == 0)
+        {
+            last--;
+        }
+        left = std::min(left, first);
+        right = std::max(right, last);
+        if(top < 0)
+        {
+            top = y;
+        }
+        bottom = y;
+    }
+    if(top < 0)
+    {
+        return QRect();
+    }
+    return QRect(left, top, right - left + 1, bottom - top + 1);
+}
+
+/**
+ * @brief packGrid places every frame in an equal cell sized for the largest one
+ * @return the size of the sheet
+ */
+static QSize packGrid(const std::vector<QRect>& sources, int padding, std::vector<QRect>& placed)
+{
+    int cellWidth = 0, cellHeight = 0;
+    for(const QRect& source : sources)
+    {
+        cellWidth = std::max(cellWidth, source.width());
+        cellHeight = std::max(cellHeight, source.height());
+    }
+    const int count = (int)sources.size();
+    const int columns = std::max(1, (int)std::ceil(std::sqrt((double)count)));
+    const int rows = (count + columns - 1) / columns;
+    for(int i = 0; i < count; i++)
+    {
+        placed[i] = QRect((i % columns) * (cellWidth + padding), (i / columns) * (cellHeight + padding),
+                          sources[i].width(), sources[i].height());
+    }
+    return QSize(columns * (cellWidth + padding) - padding, rows * (cellHeight + padding) - padding);
+}
+
+/**
+ * @brief packShelves places frames, tallest first, left to right in rows no wider than the
+ * square root of their total area, starting a new row when the next frame doesn't fit
+ * @return the size of the sheet
+ */
+static QSize packShelves(const std::vector<QRect>& sources, int padding, std::vector<QRect>& placed)
+{
+    const int count = (int)sources.size();
+    std::vector<int> order;
+    double area = 0;
+    int widest = 0;
+    for(int i = 0; i < count; i++)
+    {
+        if(sources[i].isEmpty())
+        {
+            placed[i] = QRect();
+            continue;
+        }
+        order.push_back(i);
+        area += (double)(sources[i].width() + padding) * (sources[i].height() + padding);
+        widest = std::max(widest, sources[i].width());
+    }
+    std::stable_sort(order.begin(), order.end(), [&sources](int a, int b){
+        return sources[a].height() > sources[b].height();
+    });
+
+    const int sheetWidth = std::max(widest, (int)std::ceil(std::sqrt(area)));
+    int x = 0, y = 0, shelfHeight = 0, usedWidth = 0;
+    for(int i : order)
+    {
+        const QRect& source = sources[i];
+        if(x > 0 && x + source.width() > sheetWidth)
+        {
+            y += shelfHeight + padding;
+            x = 0;
+            shelfHeight = 0;
+        }
+        placed[i] = QRect(x, y, source.width(), source.height());
+        usedWidth = std::max(usedWidth, x + source.width());
+        shelfHeight = std::max(shelfHeight, source.height());
+        x += source.width() + padding;
+    }
+    return QSize(usedWidth, y + shelfHeight);
+}
+
+static QJsonObject rectObject(const QRect& rect, int scale)
+{
+    QJsonObject object;
+    object["x"] = rect.isEmpty() ? 0 : rect.x() * scale;
+    object["y"] = rect.isEmpty() ? 0 : rect.y() * scale;
+    object["w"] = rect.isEmpty() ? 0 : rect.width() * scale;
+    object["h"] = rect.isEmpty() ? 0 : rect.height() * scale;
+    return object;
+}
+
+static QJsonObject sizeObject(const QSize& size, int scale)
+{
+    QJsonObject object;
+    object["w"] = size.width() * scale;
+    object["h"] = size.height() * scale;
+    return object;
+}
+
+bool SpriteSheet::exportSheet(const std::vector<Frame>& frames, const QString& imagePath,
+                              const QString& metadataPath, const Options& options)
+{
+    if(frames.empty())
+    {
+        return false;
+    }
+    Frame::loadAll(frames);
+
+    const int count = (int)frames.size();
+    std::vector<QImage> images(count);
+    std::vector<QRect> sources(count);
+    std::vector<int> indices(count);
+    for(int i = 0; i < count; i++)
+    {
+        images[i] = frames[i].getImage();
+        indices[i] = i;
+    }
+    const QSize frameSize = images[0].size();
+
+    QtConcurrent::blockingMap(indices, [&](int i){
+        sources[i] = options.trim ? opaqueRect(images[i]) : images[i].rect();
+    });
+
+    std::vector<QRect> placed(count);
+    const int padding = std::max(0, options.padding);
+    QSize sheetSize = options.packing == ShelfPacking ? packShelves(sources, padding, placed)
+                                                      : packGrid(sources, padding, placed);
+    sheetSize = sheetSize.expandedTo(QSize(1, 1));
+
+    // Every frame lands in its own rectangle, so they are all copied in at once, a scanline
+    // at a time straight from the frames' images into the sheet's
+    QImage sheet(sheetSize, QImage::Format_ARGB32);
+    sheet.fill(0);
+    uchar* sheetBits = sheet.bits();
+    const qsizetype sheetStride = sheet.bytesPerLine();
+    QtConcurrent::blockingMap(indices, [&](int i){
+        const QRect& source = sources[i];
+        const QRect& target = placed[i];
+        if(source.isEmpty())
+        {
+            return;
+        }
+        const size_t rowBytes = (size_t)source.width() * sizeof(QRgb);
+        for(int row = 0; row < source.height(); row++)
+        {
+            memcpy(sheetBits + (target.y() + row) * sheetStride + target.x() * sizeof(QRgb),
+                   images[i].constScanLine(source.y() + row) + source.x() * sizeof(QRgb), rowBytes);
+        }
+    });
+
+    // The sheet is packed at the frames' own size and enlarged as a whole, so the padding
+    // grows with it
+    const int scale = qBound(1, options.scale, PixelScaler::maxFactor);
+    const char* format = QFileInfo(imagePath).suffix().isEmpty() ? "PNG" : nullptr;
+    if(!PixelScaler::scale(sheet, scale).save(imagePath, format))
+    {
+        return false;
+    }
+
+    QJsonArray frameArray;
+    for(int i = 0; i < count; i++)
+    {
+        const bool trimmed = sources[i] != images[i].rect();
+        QJsonObject frame;
+        frame["filename"] = "frame" + QString::number(i);
+        frame["frame"] = rectObject(placed[i], scale);
+        frame["rotated"] = false;
+        frame["trimmed"] = trimmed;
+        frame["spriteSourceSize"] = rectObject(sources[i], scale);
+        frame["sourceSize"] = sizeObject(frameSize, scale);
+        frame["duration"] = options.frameDuration;
+        frameArray.append(frame);
+    }
+    QJsonObject meta;
+    meta["app"] = "LeSporkEditor";
+    meta["image"] = QFileInfo(imagePath).fileName();
+    meta["format"] = "RGBA8888";
+    meta["size"] = sizeObject(sheetSize, scale);
+    meta["scale"] = QString::number(scale);
+    QJsonObject metadata;
+    metadata["frames"] = frameArray;
+    metadata["meta"] = meta;
+
+    QFile metadataFile(metadataPath);
+    if(!metadataFile.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    QByteArray text = QJsonDocument(metadata).toJson();
+    return metadataFile.write(text) == text.size();
+}
+
+QString SpriteSheet::metadataPath(const QString& imagePath)
+{
+    QFileInfo info(imagePath);
+    return info.dir().filePath(info.completeBaseName() + ".json");
+}
@@ -0,0 +1,76 @@
+#ifndef SPRITESHEET_H
+#define SPRITESHEET_H
+
+#include <QString>
+#include <QRect>
+#include <vector>
+#include "frame.h"
+
+/**
+ * @brief SpriteSheet packs every frame of a Sprite into one image and describes where each
+ * frame landed in a JSON file written next to it, in the layout most engines and texture
+ * packers read:
+ *
+ *   { "frames": [ { "filename": "frame0", "frame": {x, y, w, h}, "rotated": false,
+ *                   "trimmed": true, "spriteSourceSize": {x, y, w, h}, "sourceSize": {w, h},
+ *                   "duration": ms }, ... ],
+ *     "meta": { "app": "LeSporkEditor", "image": "sheet.png", "format": "RGBA8888",
+ *               "size": {w, h}, "scale": "1" } }
+ *
+ * "frame" is the frame's rectangle in the sheet and "spriteSourceSize" the part of the
+ * original frame it holds, which is the whole frame unless transparent borders were trimmed.
+ * A frame with no opaque pixels at all trims down to an empty rectangle.
+ */
+class SpriteSheet
+{
+public:
+    /**
+     * @brief The Packing enum selects how frames are arranged in the sheet
+     */
+    enum Packing{
+        // Equal cells, as many columns as rows; every frame sits at the top left of its cell
+        GridPacking,
+        // Frames sorted by height and laid left to right in rows, for the smallest sheet when
+        // trimming leaves frames of different sizes
+        ShelfPacking
+    };
+
+    /**
+     * @brief The Options struct selects how the sheet is laid out
+     */
+    struct Options
+    {
+        Packing packing;
+        // Cut each frame down to the bounding rectangle of its non-transparent pixels
+        bool trim;
+        // Transparent pixels left between frames, so filtering never bleeds one into another
+        int padding;
+        // How long each frame is shown, recorded in the metadata
+        int frameDuration;
+        // How many times larger the sheet is written, each pixel becoming a square block; the
+        // metadata gives rectangles in the enlarged sheet
+        int scale;
+
+        Options() : packing(GridPacking), trim(false), padding(0), frameDuration(100), scale(1) {}
+    };
+
+    /**
+     * @brief exportSheet packs the frames into one image and saves it with its metadata
+     * @param frames the frames of the Sprite, in order; all the same size
+     * @param imagePath the image to write; its format is taken from the suffix, PNG if none
+     * @param metadataPath the JSON metadata to write
+     * @param options how the sheet is laid out
+     * @return a true/false on whether the image and the metadata were both written
+     */
+    static bool exportSheet(const std::vector<Frame>& frames, const QString& imagePath,
+                            const QString& metadataPath, const Options& options = Options());
+
+    /**
+     * @brief metadataPath returns where the metadata of a sheet is written by default: next to
+     * the image, with its suffix replaced by .json
+     * @param imagePath the image of the sheet
+     */
+    static QString metadataPath(const QString& imagePath);
+};
+
+#endif // SPRITESHEET_H
@@ -0,0 +1,182 @@
+#include "videostream.h"
+#include "engineexport.h"
+#include "pixelscaler.h"
+#include <QFileInfo>
+#include <QFuture>
+#include <QtConcurrent>
+#include <cstring>
+
+/**
+ * @brief blend puts one channel of a pixel over the background's
+ */
+static inline int blend(int channel, int background, int alpha)
+{
+    return (channel * alpha + background * (255 - alpha) + 127) / 255;
+}
+
+/**
+ * @brief widenPlaneRow repeats every byte of a plane's row factor times
+ */
+static void widenPlaneRow(const uchar* values, int width, int factor, uchar* out)
+{
+    for(int x = 0; x < width; x++)
+    {
+        memset(out + x * factor, values[x], factor);
+    }
+}
+
+/**
+ * @brief copyRowDown copies the first row of each block of factor rows over the rest
+ */
+static void copyRowDown(uchar* row, qsizetype rowBytes, int factor)
+{
+    for(int copy = 1; copy < factor; copy++)
+    {
+        memcpy(row + copy * rowBytes, row, rowBytes);
+    }
+}
+
+/**
+ * @brief y4mFrame converts a frame to its "FRAME" line and Y, U and V planes. Each source row
+ * is converted once at its own width, then widened and copied down its block
+ */
+static QByteArray y4mFrame(const QImage& image, const VideoStream::Options& options)
+{
+    const int width = image.width();
+    const int factor = options.scale;
+    const qsizetype planeWidth = (qsizetype)width * factor;
+    const qsizetype planeSize = planeWidth * image.height() * factor;
+    static const char frameTag[] = "FRAME\n";
+
+    QByteArray frame(6 + planeSize * 3, '\0');
+    memcpy(frame.data(), frameTag, 6);
+    uchar* planes[3];
+    for(int p = 0; p < 3; p++)
+    {
+        planes[p] = (uchar*)frame.data() + 6 + p * planeSize;
+    }
+
+    std::vector<uchar> rows[3];
+    for(int p = 0; p < 3; p++)
+    {
+        rows[p].resize(width);
+    }
+    const int backgroundRed = qRed(options.background);
+    const int backgroundGreen = qGreen(options.background);
+    const int backgroundBlue = qBlue(options.background);
+    for(int y = 0; y < image.height(); y++)
+    {
+        const QRgb* pixels = (const QRgb*)image.constScanLine(y);
+        for(int x = 0; x < width; x++)
+        {
+            const int alpha = qAlpha(pixels[x]);
+            const int r = blend(qRed(pixels[x]), backgroundRed, alpha);
+            const int g = blend(qGreen(pixels[x]), backgroundGreen, alpha);
+            const int b = blend(qBlue(pixels[x]), backgroundBlue, alpha);
+            // BT.601 in limited range, in 8.8 fixed point; the chroma offset is added before
+            // shifting so the sums are never negative
+            rows[0][x] = (uchar)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            rows[1][x] = (uchar)((-38 * r - 74 * g + 112 * b + 32896) >> 8);
+            rows[2][x] = (uchar)((112 * r - 94 * g - 18 * b + 32896) >> 8);
+        }
+        for(int p = 0; p < 3; p++)
+        {
+            uchar* row = planes[p] + y * factor * planeWidth;
+            widenPlaneRow(rows[p].data(), width, factor, row);
+            copyRowDown(row, planeWidth, factor);
+        }
+    }
+    return frame;
+}
+
+/**
+ * @brief rgbaFrame converts a frame to R, G, B, A bytes, each source row converted once at its
+ * own width, then widened and copied down its block
+ */
+static QByteArray rgbaFrame(const QImage& image, const VideoStream::Options& options)
+{
+    const int width = image.width();
+    const int factor = options.scale;
+    const qsizetype rowBytes = (qsizetype)width * factor * 4;
+
+    QByteArray frame(rowBytes * image.height() * factor, '\0');
+    std::vector<QRgb> converted(width);
+    for(int y = 0; y < image.height(); y++)
+    {
+        EngineExport::convertPixels((const QRgb*)image.constScanLine(y), width, EngineExport::Rgba8888,
+                                    (uchar*)converted.data());
+        uchar* row = (uchar*)frame.data() + y * factor * rowBytes;
+        PixelScaler::widenRow(converted.data(), width, factor, (QRgb*)row);
+        copyRowDown(row, rowBytes, factor);
+    }
+    return frame;
+}
+
+static QByteArray convertFrame(const QImage& image, const VideoStream::Options& options)
+{
+    return options.format == VideoStream::RawRgbaFormat ? rgbaFrame(image, options) : y4mFrame(image, options);
+}
+
+bool VideoStream::write(QIODevice& device, const std::vector<Frame>& frames, const Options& options)
+{
+    if(frames.empty())
+    {
+        return false;
+    }
+    Frame::loadAll(frames);
+
+    Options settings = options;
+    settings.scale = qBound(1, options.scale, PixelScaler::maxFactor);
+    settings.fps = qMax(1, options.fps);
+    settings.loops = qMax(1, options.loops);
+
+    const int count = (int)frames.size();
+    std::vector<QImage> images(count);
+    for(int i = 0; i < count; i++)
+    {
+        images[i] = frames[i].getImage();
+        if(images[i].format() != QImage::Format_ARGB32)
+        {
+            images[i] = images[i].convertToFormat(QImage::Format_ARGB32);
+        }
+    }
+
+    if(settings.format == Y4mFormat)
+    {
+        QByteArray header = "YUV4MPEG2 W" + QByteArray::number(images[0].width() * settings.scale)
+                          + " H" + QByteArray::number(images[0].height() * settings.scale)
+                          + " F" + QByteArray::number(settings.fps) + ":1 Ip A1:1 C444 XCOLORRANGE=LIMITED\n";
+        if(device.write(header) != header.size())
+        {
+            return false;
+        }
+    }
+
+    // The worker converts frame i + 1 while frame i is written, which for a pipe also waits
+    // for the reader to take it
+    const int total = count * settings.loops;
+    auto convert = [&images, &settings, count](int i){
+        return convertFrame(images[i % count], settings);
+    };
+    QFuture<QByteArray> next = QtConcurrent::run(convert, 0);
+    for(int i = 0; i < total; i++)
+    {
+        const QByteArray current = next.result();
+        if(i + 1 < total)
+        {
+            next = QtConcurrent::run(convert, i + 1);
+        }
+        if(device.write(current) != current.size())
+        {
+            next.waitForFinished();
+            return false;
+        }
+    }
+    return true;
+}
+
+VideoStream::Format VideoStream::formatForPath(const QString& filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    return suffix == "rgba" || suffix == "raw" ? RawRgbaFormat : Y4mFormat;
+}
@@ -0,0 +1,67 @@
+#ifndef VIDEOSTREAM_H
+#define VIDEOSTREAM_H
+
+#include <QIODevice>
+#include <QImage>
+#include <vector>
+#include "frame.h"
+
+/**
+ * @brief VideoStream writes the animation as an uncompressed video stream that ffmpeg and most
+ * other encoders read from a file or a pipe, so a video can be made without temporary images:
+ *
+ *   YUV4MPEG2  a one line header giving the size and frame rate, then each frame as "FRAME\n"
+ *              and its Y, U and V planes at full resolution (4:4:4), BT.601 limited range.
+ *              YUV has no alpha, so pixels are blended over a background color first.
+ *   Raw RGBA   each frame's pixels as R, G, B, A bytes, top row first, with no header; the
+ *              reader has to be told the size, frame rate and -pix_fmt rgba.
+ *
+ * Frames are enlarged as they are converted, each pixel becoming a square block. While one
+ * frame is written a worker converts the next, so at most two frames are held at a time.
+ */
+class VideoStream
+{
+public:
+    /**
+     * @brief The Format enum selects how frames are stored in the stream
+     */
+    enum Format{
+        Y4mFormat,
+        RawRgbaFormat
+    };
+
+    /**
+     * @brief The Options struct selects how the stream is written
+     */
+    struct Options
+    {
+        Format format;
+        // How many times larger each frame is written
+        int scale;
+        // Frames per second, recorded in the YUV4MPEG2 header
+        int fps;
+        // How many times the animation is played
+        int loops;
+        // The color transparent pixels are blended over for YUV4MPEG2
+        QRgb background;
+
+        Options() : format(Y4mFormat), scale(1), fps(12), loops(1), background(qRgb(0, 0, 0)) {}
+    };
+
+    /**
+     * @brief write converts and writes every frame, in order
+     * @param device an open, writable device, which may be a pipe
+     * @param frames the frames of the Sprite, in order; all the same size
+     * @param options how the stream is written
+     * @return a true/false on whether every byte was written
+     */
+    static bool write(QIODevice& device, const std::vector<Frame>& frames, const Options& options = Options());
+
+    /**
+     * @brief formatForPath picks the format from a filepath's suffix: raw RGBA for .rgba and
+     * .raw, YUV4MPEG2 for anything else
+     */
+    static Format formatForPath(const QString& filePath);
+};
+
+#endif // VIDEOSTREAM_H